@@ -2,11 +2,19 @@
 | This file is distributed under the BSD 2-Clause License.
 | See LICENSE for details.
 *-----------------------------------------------------------------------------*/
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <chrono>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "spdlog/spdlog.h"
+#include "spdlog/sinks/ostream_sink.h"
 
 extern "C" {
 #include <aig/gia/gia.h>
@@ -14,151 +22,957 @@ extern "C" {
 
 #include "collapse.hpp"
 #include "kernel/cube32.hpp"
+#include "kernel/cube32_sort.hpp"
 #include "kernel/two_lvl32.hpp"
+#include "kernel/truth_table.hpp"
+#include "kernel/xor_set32.hpp"
+#include "opt/exorcism32.hpp"
+#include "opt/tt_esop.hpp"
 
 namespace lsy {
 
-aig_extr_mngr::aig_extr_mngr(Gia_Man_t *aig)
-	: m_aig(aig)
+aig_extr_mngr::aig_extr_mngr(Gia_Man_t *aig, const aig_extr_params &params)
+	: m_aig(aig), m_params(params)
 {
 	_clogger = spdlog::get("console");
 	_dlogger = spdlog::get("data");
 }
 
+/* Logs the data of a group of cones to its own logger, with the ids of the AIG
+ * partitioned */
+void aig_extr_mngr::log_to(const cone_log &log)
+{
+	_dlogger = log.logger;
+	m_cone_log = &log;
+}
+
+/*------------------------------------------------------------------------------
+| Recognizes the XOR and MUX structures of the AIG. Such a node is collapsed
+| directly from the leaves of its structure, so its two inner AND nodes are
+| only collapsed if something else uses them. The leaves of every AND node are
+| stored as literals: the fanins, the XOR inputs, or the MUX control, then and
+| else inputs.
+*-----------------------------------------------------------------------------*/
+void aig_extr_mngr::recognize()
+{
+	std::uint32_t i;
+	Gia_Obj_t *obj, *fan0, *fan1, *ctrl;
+
+	m_types.assign(Gia_ManObjNum(m_aig), NODE_AND);
+	m_leaves.assign(Gia_ManObjNum(m_aig), {{0u, 0u, 0u}});
+	Gia_ManForEachAnd(m_aig, obj, i) {
+		if (m_params.xor_mux && Gia_ObjRecognizeExor(obj, &fan0, &fan1)) {
+			m_types[i] = NODE_XOR;
+			m_leaves[i] = {{(std::uint32_t) Gia_ObjToLit(m_aig, fan0),
+			                (std::uint32_t) Gia_ObjToLit(m_aig, fan1), 0u}};
+		} else if (m_params.xor_mux && Gia_ObjIsMuxType(obj)) {
+			ctrl = Gia_ObjRecognizeMux(obj, &fan0, &fan1);
+			m_types[i] = NODE_MUX;
+			m_leaves[i] = {{(std::uint32_t) Gia_ObjToLit(m_aig, ctrl),
+			                (std::uint32_t) Gia_ObjToLit(m_aig, fan0),
+			                (std::uint32_t) Gia_ObjToLit(m_aig, fan1)}};
+		} else {
+			m_leaves[i] = {{(std::uint32_t) Gia_ObjToLit(m_aig, Gia_ObjChild0(obj)),
+			                (std::uint32_t) Gia_ObjToLit(m_aig, Gia_ObjChild1(obj)), 0u}};
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------
+| Computes the order in which nodes are collapsed: a depth-first traversal from
+| each CO in turn, visiting the deepest leaf first, so that the ESOPs of a
+| cone can be released soon after the cone is done. Each CO follows its cone.
+| Nodes outside the COs' cones are never scheduled.
+|
+| Also counts the fanout references of each node among the scheduled nodes, and
+| makes each CO driven by the same node as an earlier CO a reference to it, the
+| complement of it if their edges differ.
+*-----------------------------------------------------------------------------*/
+void aig_extr_mngr::schedule()
+{
+	std::uint32_t i;
+	Gia_Obj_t *obj;
+	std::vector<std::uint8_t> visited(Gia_ManObjNum(m_aig), 0);
+	std::vector<std::pair<std::uint32_t, bool>> stack;
+	const std::uint32_t n_cos = Gia_ManCoNum(m_aig);
+	std::vector<std::uint32_t> first_co(Gia_ManObjNum(m_aig), n_cos);
+
+	Gia_ManLevelNum(m_aig);
+	recognize();
+	m_order.clear();
+	m_n_nodes.fill(0u);
+	m_refs.assign(Gia_ManObjNum(m_aig), 0);
+	m_co_refs.resize(n_cos);
+	Gia_ManForEachCo(m_aig, obj, i) {
+		auto &first = first_co[Gia_ObjFaninId0p(m_aig, obj)];
+		if (first == n_cos)
+			first = i;
+		m_co_refs[i] = {first, Gia_ObjFaninC0(obj) != Gia_ObjFaninC0(Gia_ManCo(m_aig, first))};
+		stack.emplace_back(Gia_ObjFaninId0p(m_aig, obj), false);
+		while (!stack.empty()) {
+			const auto id = stack.back().first;
+			const auto done = stack.back().second;
+			stack.pop_back();
+			if (done) {
+				m_order.push_back(id);
+				++m_n_nodes[m_types[id]];
+				continue;
+			}
+			if (visited[id])
+				continue;
+			visited[id] = 1;
+			if (!Gia_ObjIsAnd(Gia_ManObj(m_aig, id)))
+				continue;
+			std::array<std::uint32_t, 3> leaves;
+			const auto n_leaves = n_leaves_of(id);
+			for (auto l = 0u; l < n_leaves; ++l)
+				leaves[l] = Abc_Lit2Var(m_leaves[id][l]);
+			std::stable_sort(leaves.begin(), leaves.begin() + n_leaves,
+				[this](std::uint32_t a, std::uint32_t b) {
+					return Gia_ObjLevelId(m_aig, a) < Gia_ObjLevelId(m_aig, b);
+				});
+			stack.emplace_back(id, true);
+			for (auto l = 0u; l < n_leaves; ++l) {
+				++m_refs[leaves[l]];
+				stack.emplace_back(leaves[l], false);
+			}
+		}
+		++m_refs[Gia_ObjFaninId0p(m_aig, obj)];
+		m_order.push_back(Gia_ObjId(m_aig, obj));
+	}
+	compute_supports();
+	find_twins();
+}
+
+/*------------------------------------------------------------------------------
+| Structural supports of the scheduled nodes, and the nodes whose ESOP is
+| needed: those driving a CO or feeding a node too wide for truth tables.
+*-----------------------------------------------------------------------------*/
+void aig_extr_mngr::compute_supports()
+{
+	std::uint32_t i, id;
+
+	m_supports.assign(Gia_ManObjNum(m_aig), 0u);
+	m_needs_esop.assign(Gia_ManObjNum(m_aig), 0u);
+	Gia_ManForEachCiId(m_aig, id, i)
+		m_supports[id] = 1u << i;
+	for (const auto idx : m_order) {
+		auto obj = Gia_ManObj(m_aig, idx);
+		if (Gia_ObjIsCo(obj)) {
+			m_needs_esop[Gia_ObjFaninId0p(m_aig, obj)] = 1u;
+			continue;
+		}
+		for (auto l = 0u; l < n_leaves_of(idx); ++l)
+			m_supports[idx] |= m_supports[Abc_Lit2Var(m_leaves[idx][l])];
+		if (is_narrow(idx))
+			continue;
+		for (auto l = 0u; l < n_leaves_of(idx); ++l)
+			m_needs_esop[Abc_Lit2Var(m_leaves[idx][l])] = 1u;
+	}
+}
+
+struct cone_key_hash {
+	std::size_t operator()(const std::vector<std::uint32_t> &key) const
+	{
+		std::uint64_t h = key.size();
+		for (const auto k : key)
+			h = (h ^ k) * 0x100000001B3ull;
+		return h;
+	}
+};
+
+/*------------------------------------------------------------------------------
+| Structural memoization: the cones of the wide nodes, up to 'memo_cone' nodes,
+| are serialized by 'cone_key' and the nodes of equal keys are twins. Each one
+| refers to the first of them in the collapse order, which it holds a fanout
+| reference to until its own ESOP is instantiated from it.
+*-----------------------------------------------------------------------------*/
+void aig_extr_mngr::find_twins()
+{
+	m_twins.assign(Gia_ManObjNum(m_aig), 0u);
+	m_cone_vars.assign(Gia_ManObjNum(m_aig), {});
+	m_n_twins = 0u;
+	if (m_params.memo_cone == 0u)
+		return;
+	std::unordered_map<std::vector<std::uint32_t>, std::uint32_t, cone_key_hash> firsts;
+	std::vector<std::uint32_t> local(Gia_ManObjNum(m_aig),
+	                                 std::numeric_limits<std::uint32_t>::max());
+	std::vector<std::uint32_t> key;
+	for (const auto idx : m_order) {
+		if (!Gia_ObjIsAnd(Gia_ManObj(m_aig, idx)) || is_narrow(idx))
+			continue;
+		if (!cone_key(idx, local, key, m_cone_vars[idx]))
+			continue;
+		auto it = firsts.emplace(key, idx);
+		if (it.second)
+			continue;
+		m_twins[idx] = it.first->second;
+		++m_refs[m_twins[idx]];
+		++m_n_twins;
+	}
+}
+
+/*------------------------------------------------------------------------------
+| Serializes the cone of 'root' in post-order, the leaves of each node taken in
+| order: a record per cone node, 0 for a CI, 1 for the constant, or 2 plus the
+| node type followed by its leaves as literals of the cone numbering. Records
+| are told apart by their first word, so equal keys are isomorphic cones. The
+| CIs are listed in 'vars' in the order of the traversal. Fails on cones of
+| more than 'memo_cone' nodes. 'local' must be all-unset, and is left so.
+*-----------------------------------------------------------------------------*/
+bool aig_extr_mngr::cone_key(const std::uint32_t root, std::vector<std::uint32_t> &local,
+                             std::vector<std::uint32_t> &key,
+                             std::vector<std::uint8_t> &vars) const
+{
+	static constexpr auto unset = std::numeric_limits<std::uint32_t>::max();
+	static constexpr auto pending = unset - 1u;
+	std::vector<std::pair<std::uint32_t, bool>> stack;
+	std::vector<std::uint32_t> touched;
+	std::uint32_t n_nodes = 0u;
+	auto ok = true;
+
+	key.clear();
+	vars.clear();
+	stack.emplace_back(root, false);
+	while (!stack.empty()) {
+		const auto id = stack.back().first;
+		const auto done = stack.back().second;
+		stack.pop_back();
+		auto obj = Gia_ManObj(m_aig, id);
+		if (done) {
+			local[id] = n_nodes++;
+			key.push_back(2u + m_types[id]);
+			for (auto l = 0u; l < n_leaves_of(id); ++l) {
+				const auto leaf = m_leaves[id][l];
+				key.push_back(Abc_Var2Lit(local[Abc_Lit2Var(leaf)], Abc_LitIsCompl(leaf)));
+			}
+			continue;
+		}
+		if (local[id] != unset)
+			continue;
+		touched.push_back(id);
+		if (!Gia_ObjIsAnd(obj)) {
+			local[id] = n_nodes++;
+			key.push_back(Gia_ObjIsCi(obj) ? 0u : 1u);
+			if (Gia_ObjIsCi(obj))
+				vars.push_back(Gia_ObjCioId(obj));
+			continue;
+		}
+		if (touched.size() > m_params.memo_cone) {
+			ok = false;
+			break;
+		}
+		local[id] = pending;
+		stack.emplace_back(id, true);
+		for (auto l = n_leaves_of(id); l-- > 0u;)
+			stack.emplace_back(Abc_Lit2Var(m_leaves[id][l]), false);
+	}
+	for (const auto id : touched)
+		local[id] = unset;
+	return ok;
+}
+
+bool aig_extr_mngr::is_narrow(const std::uint32_t idx) const
+{
+	const auto max_support = std::min(m_params.tt_support, 16u);
+	return (std::uint32_t) __builtin_popcount(m_supports[idx]) <= max_support
+	       && max_support > 0u;
+}
+
+std::uint32_t aig_extr_mngr::n_leaves_of(const std::uint32_t idx) const
+{
+	return m_types[idx] == NODE_MUX ? 3u : 2u;
+}
+
+/*------------------------------------------------------------------------------
+| Memory accounting: 'acquire' is called once a node's ESOP is built, and
+| 'release' each time one of its fanouts has consumed it. The ESOP, capacity
+| included, is freed with its last reference.
+*-----------------------------------------------------------------------------*/
+void aig_extr_mngr::acquire(const std::uint32_t idx)
+{
+	m_live_cubes += m_esops[idx].capacity();
+	m_peak_cubes = std::max(m_peak_cubes, m_live_cubes);
+}
+
+void aig_extr_mngr::release(const std::uint32_t idx)
+{
+	assert(m_refs[idx] > 0);
+	if (--m_refs[idx] > 0)
+		return;
+	m_live_cubes -= m_esops[idx].capacity();
+	std::vector<cube32>().swap(m_esops[idx]);
+	std::vector<std::uint64_t>().swap(m_tts[idx]);
+}
+
+void aig_extr_mngr::release_leaves(const std::uint32_t idx)
+{
+	if (m_twins[idx] != 0u)
+		release(m_twins[idx]);
+	for (auto l = 0u; l < n_leaves_of(idx); ++l)
+		release(Abc_Lit2Var(m_leaves[idx][l]));
+}
+
 two_lvl32 aig_extr_mngr::run(bool verbose = false)
 {
-	using time = std::chrono::high_resolution_clock;
 	m_esops.resize(Gia_ManObjNum(m_aig));
 	std::uint32_t i, id;
-	Gia_Obj_t *obj;
 
 	_clogger->info_if(verbose, "Collapsing using AIG");
 
 	if (_dlogger != nullptr) {
 		_dlogger->info("# [%c] - AIG collapsing");
 	}
-	/* Elementary input ESOPs */
+	schedule();
+	m_live_cubes = m_peak_cubes = 0;
+	m_n_minimized = m_n_saved = 0;
+
+	/* Elementary input ESOPs and truth tables */
+	m_tts.assign(Gia_ManObjNum(m_aig), {});
+	m_tts[0] = {0u};
 	Gia_ManForEachCiId(m_aig, id, i) {
 		cube32 cube((1 << i), (1 << i));
 		m_esops[id].push_back(cube);
+		m_tts[id] = {tt_vars[0]};
+		acquire(id);
 	}
 
-	Gia_ManForEachAnd(m_aig, obj, i) {
-		auto start = time::now();
-		prepare_input(Gia_ObjFaninId0(obj, i), Gia_ObjFaninC0(obj), m_esop0);
-		prepare_input(Gia_ObjFaninId1(obj, i), Gia_ObjFaninC1(obj), m_esop1);
-		compute_and(i);
-		auto end = time::now();
-		std::chrono::duration<double> duration = end - start;
+	std::vector<std::vector<cube32>> ret(Gia_ManCoNum(m_aig));
+	if (m_params.n_threads > 1)
+		run_levels(ret, verbose);
+	else
+		run_serial(ret, verbose);
+	if (verbose)
+		fprintf(stdout, "\n");
+	_clogger->info_if(verbose, "Collapsed nodes: {} AND, {} XOR, {} MUX",
+	                  m_n_nodes[NODE_AND], m_n_nodes[NODE_XOR], m_n_nodes[NODE_MUX]);
+	_clogger->info_if(verbose && m_n_twins > 0, "Memoized cones: {} nodes", m_n_twins);
+	_clogger->info_if(verbose && m_n_minimized > 0,
+	                  "Intermediate exorcism: {} nodes, {} cubes saved",
+	                  m_n_minimized, m_n_saved);
+	_clogger->info_if(verbose, "Peak memory of intermediate ESOPs: {} cubes ({:.2f} MB)",
+	                  m_peak_cubes, m_peak_cubes * sizeof(cube32) / 1048576.0);
+	if (_dlogger != nullptr) {
+		_dlogger->info("# peak cubes: {}", m_peak_cubes);
+		_dlogger->info("# AND/XOR/MUX nodes: {},{},{}", m_n_nodes[NODE_AND],
+			       m_n_nodes[NODE_XOR], m_n_nodes[NODE_MUX]);
+	}
+	return {two_lvl32::kind_t::ESOP, (std::uint32_t) Gia_ManCiNum(m_aig), ret, m_co_refs};
+}
+
+void aig_extr_mngr::run_serial(std::vector<std::vector<cube32>> &ret, bool verbose)
+{
+	m_scratch.assign(1, scratch(Gia_ManCiNum(m_aig)));
+	auto n_done = 0u;
+	for (const auto idx : m_order) {
+		auto obj = Gia_ManObj(m_aig, idx);
+		if (Gia_ObjIsCo(obj)) {
+			collapse_co(idx, ret);
+			continue;
+		}
+		const auto stats = collapse_node(idx, m_scratch[0]);
+		acquire(idx);
+		release_leaves(idx);
 		if (verbose) {
 			fprintf(stdout, "\rNode %6d / %6lu, child 1: %6lu child 2: %6lu",
-				i, m_esops.size(), m_esop0.size(), m_esop1.size());
+				++n_done, m_order.size(), stats.size0, stats.size1);
 			fflush(stdout);
 		}
-		if (_dlogger != nullptr) {
-			_dlogger->info("{},{},{},{},{}", i, m_esop0.size(),
-				       m_esop1.size(),m_esops[i].size(),
-				       duration.count());
+		log_node(idx, stats);
+	}
+}
+
+/*------------------------------------------------------------------------------
+| Level-parallel collapsing: all AND nodes of a level only depend on nodes of
+| lower levels, so they are collapsed concurrently, each worker with its own
+| temporaries. Memory bookkeeping is left to the calling thread, once the whole
+| level is done: no ESOP a level reads can be released before the level ends.
+*-----------------------------------------------------------------------------*/
+void aig_extr_mngr::run_levels(std::vector<std::vector<cube32>> &ret, bool verbose)
+{
+	std::vector<std::vector<std::uint32_t>> nodes;
+	std::vector<std::vector<std::uint32_t>> cos;
+	for (const auto idx : m_order) {
+		auto obj = Gia_ManObj(m_aig, idx);
+		const std::uint32_t level = Gia_ObjLevelId(m_aig, Gia_ObjIsCo(obj)
+			? Gia_ObjFaninId0p(m_aig, obj) : idx);
+		if (level >= nodes.size()) {
+			nodes.resize(level + 1);
+			cos.resize(level + 1);
 		}
+		(Gia_ObjIsCo(obj) ? cos : nodes)[level].push_back(idx);
 	}
-	if (verbose)
-		fprintf(stdout, "\n");
-	std::vector<std::vector<cube32>> ret = {};
-	Gia_ManForEachCo(m_aig, obj, i) {
-		auto start = time::now();
-		prepare_input(Gia_ObjFaninId0p(m_aig, obj), Gia_ObjFaninC0(obj), m_esop0);
-		ret.push_back(m_esop0);
-		auto end = time::now();
-		std::chrono::duration<double> duration = end - start;
-		if (_dlogger != nullptr) {
-			_dlogger->info("{},{},-1,-1,{}", i, m_esop0.size(),
-				       duration.count());
-		}
-	}
-	return {two_lvl32::kind_t::ESOP, (std::uint32_t) Gia_ManCiNum(m_aig), ret};
-}
-
-void aig_extr_mngr::prepare_input(const std::uint32_t idx, std::uint32_t cmpl, std::vector<cube32> &out)
-{
-	auto offset = 0;
-	out.clear();
-	if (cmpl) {
-		if (m_esops[idx].empty())
-			out.push_back(cube32_one);
-		else {
-			cube32 first = m_esops[idx].front();
-			if (first == cube32_one)
-				offset = 1;
-			else if (first.n_lits() == 1) {
-				first.invert();
-				out.push_back(first);
-				offset = 1;
-			} else {
-				out.push_back(cube32_one);
-			}
+
+	m_pool.reset(new thread_pool(m_params.n_threads));
+	m_scratch.assign(m_pool->size(), scratch(Gia_ManCiNum(m_aig)));
+	std::vector<node_stats> stats;
+	std::vector<std::uint32_t> huge;
+	for (auto level = 0u; level < nodes.size(); ++level) {
+		auto &level_nodes = nodes[level];
+		/* Huge nodes go after the others, to be collapsed with all threads
+		 * each, and twins last, as their first twin can be of the level */
+		auto twins = std::stable_partition(level_nodes.begin(), level_nodes.end(),
+			[this](std::uint32_t idx) { return m_twins[idx] == 0u; });
+		auto mid = std::stable_partition(level_nodes.begin(), twins,
+			[this](std::uint32_t idx) { return !is_huge(idx); });
+		const std::size_t n_small = std::distance(level_nodes.begin(), mid);
+		const std::size_t n_firsts = std::distance(level_nodes.begin(), twins);
+		stats.resize(level_nodes.size());
+		m_pool->parallel_for(n_small,
+			[&](std::size_t i, std::uint32_t worker) {
+				stats[i] = collapse_node(level_nodes[i], m_scratch[worker]);
+			});
+		for (auto i = n_small; i < n_firsts; ++i)
+			stats[i] = collapse_node(level_nodes[i], m_scratch[0], true);
+		m_pool->parallel_for(level_nodes.size() - n_firsts,
+			[&](std::size_t i, std::uint32_t worker) {
+				stats[n_firsts + i] = collapse_node(level_nodes[n_firsts + i],
+				                                    m_scratch[worker]);
+			});
+		for (auto i = 0u; i < level_nodes.size(); ++i) {
+			const auto idx = level_nodes[i];
+			acquire(idx);
+			release_leaves(idx);
+			log_node(idx, stats[i]);
+		}
+		for (const auto idx : cos[level])
+			collapse_co(idx, ret);
+		if (verbose) {
+			fprintf(stdout, "\rLevel %4u / %4lu, nodes: %6lu",
+				level, nodes.size() - 1, level_nodes.size());
+			fflush(stdout);
 		}
 	}
-	out.insert(out.end(), m_esops[idx].begin() + offset, m_esops[idx].end());
+	m_pool.reset();
+}
+
+/*------------------------------------------------------------------------------
+| Whether a node is worth a parallel product, estimating its number of products
+| from the sizes of its fanin ESOPs (complementing may add a cube).
+*-----------------------------------------------------------------------------*/
+bool aig_extr_mngr::is_huge(const std::uint32_t idx) const
+{
+	if (!m_params.radix || m_types[idx] != NODE_AND || is_narrow(idx))
+		return false;
+	const std::uint64_t size0 = m_esops[Abc_Lit2Var(m_leaves[idx][0])].size() + 1;
+	const std::uint64_t size1 = m_esops[Abc_Lit2Var(m_leaves[idx][1])].size() + 1;
+	return size0 * size1 >= m_params.parallel_product;
 }
 
-void aig_extr_mngr::compute_and(std::uint32_t index)
+aig_extr_mngr::node_stats aig_extr_mngr::collapse_node(const std::uint32_t idx, scratch &ws,
+                                                       bool parallel)
 {
-	/* one of the children is 0 function */
-	if (m_esop0.empty() || m_esop1.empty())
+	using time = std::chrono::high_resolution_clock;
+	auto start = time::now();
+	const auto &leaves = m_leaves[idx];
+	node_stats stats = {0u, 0u, 0.0, 0u, -1.0};
+	if (m_twins[idx] != 0u) {
+		instantiate(idx);
+	} else if (is_narrow(idx)) {
+		collapse_tt(idx);
+	} else {
+		if (m_types[idx] == NODE_MUX) {
+			compute_mux(idx, ws);
+		} else {
+			ws.esop0 = fanin(leaves[0]);
+			ws.esop1 = fanin(leaves[1]);
+			if (m_types[idx] == NODE_XOR)
+				compute_xor(idx, ws);
+			else
+				compute_and(idx, ws, parallel);
+		}
+		stats.size0 = ws.esop0.size();
+		stats.size1 = ws.esop1.size();
+	}
+	if (m_twins[idx] == 0u)
+		minimize(idx, stats);
+	/* Constant-one cube first, for the fanin views of the fanouts */
+	auto &esop = m_esops[idx];
+	auto one = std::find(esop.begin(), esop.end(), cube32_one);
+	if (one != esop.end())
+		std::iter_swap(esop.begin(), one);
+	std::chrono::duration<double> duration = time::now() - start;
+	stats.time = duration.count();
+	return stats;
+}
+
+/* Maps the bits 0..k-1 of 'bits' to the positions of the 'k' bits of 'support' */
+static std::uint32_t deposit(std::uint32_t bits, std::uint32_t support)
+{
+	std::uint32_t ret = 0u;
+	for (; support != 0u; support &= support - 1u, bits >>= 1) {
+		if (bits & 1u)
+			ret |= support & (~support + 1u);
+	}
+	return ret;
+}
+
+/*------------------------------------------------------------------------------
+| Truth table path for nodes of small support: the node's table, over its
+| support, is computed word-wise from the tables of its leaves, expanded to
+| that support. The ESOP is only derived from the table, by 'tt_esop', when a
+| CO or a wide fanout needs it.
+*-----------------------------------------------------------------------------*/
+void aig_extr_mngr::collapse_tt(const std::uint32_t idx)
+{
+	const auto support = m_supports[idx];
+	const std::uint32_t n_vars = __builtin_popcount(support);
+	std::array<std::vector<std::uint64_t>, 3> inputs;
+	std::vector<std::uint32_t> pos;
+	for (auto l = 0u; l < n_leaves_of(idx); ++l) {
+		const auto leaf = Abc_Lit2Var(m_leaves[idx][l]);
+		auto &tt = inputs[l];
+		tt = m_tts[leaf];
+		pos.clear();
+		for (auto bits = m_supports[leaf]; bits != 0u; bits &= bits - 1u)
+			pos.push_back(__builtin_popcount(support & ((bits & (~bits + 1u)) - 1u)));
+		tt_expand(tt, n_vars, pos);
+		if (Abc_LitIsCompl(m_leaves[idx][l])) {
+			for (auto &w : tt)
+				w = ~w;
+		}
+	}
+	auto &tt = m_tts[idx];
+	tt.resize(tt_n_words(n_vars));
+	for (auto i = 0u; i < tt.size(); ++i) {
+		switch (m_types[idx]) {
+		case NODE_XOR:
+			tt[i] = inputs[0][i] ^ inputs[1][i];
+			break;
+		case NODE_MUX:
+			tt[i] = (inputs[0][i] & inputs[1][i]) | (~inputs[0][i] & inputs[2][i]);
+			break;
+		default:
+			tt[i] = inputs[0][i] & inputs[1][i];
+		}
+	}
+	if (!m_needs_esop[idx])
 		return;
-	for (const auto &cube0 : m_esop0) {
-		/* left child is 1 function */
-		if (cube0 == cube32_one) {
-			for (const auto& cube1 : m_esop1)
-				add_cube(cube1);
-			continue;
+	for (const auto &c : tt_esop(tt, n_vars))
+		m_esops[idx].emplace_back(deposit(c.mask, support), deposit(c.polarity, support));
+}
+
+/*------------------------------------------------------------------------------
+| Memoized node: its cone is isomorphic to the one of its first twin, so its
+| ESOP is the twin's one, each variable renamed to the CI of the same position
+| in this cone's traversal.
+*-----------------------------------------------------------------------------*/
+void aig_extr_mngr::instantiate(const std::uint32_t idx)
+{
+	const auto twin = m_twins[idx];
+	std::array<std::uint32_t, 32> rename = {};
+	for (auto k = 0u; k < m_cone_vars[idx].size(); ++k)
+		rename[m_cone_vars[twin][k]] = 1u << m_cone_vars[idx][k];
+	auto &esop = m_esops[idx];
+	esop.reserve(m_esops[twin].size());
+	for (const auto &c : m_esops[twin]) {
+		cube32 cube;
+		for (auto bits = c.mask; bits != 0u; bits &= bits - 1u) {
+			const auto var = __builtin_ctz(bits);
+			cube.mask |= rename[var];
+			if ((c.polarity >> var) & 1u)
+				cube.polarity |= rename[var];
 		}
-		for (const auto &cube1 : m_esop1) {
-			if (cube1 == cube32_one) {
-				add_cube(cube0);
-				continue;
+		esop.push_back(cube);
+	}
+}
+
+/*------------------------------------------------------------------------------
+| Runs a bounded-effort exorcism on the node's ESOP when it has more than
+| 'exorcism_size' cubes, or more than 'exorcism_growth' times the cubes of its
+| largest leaf. Growth is only checked for ESOPs worth the set-up of exorcism,
+| and not for narrow nodes: their leaves may have no ESOP, and their own ESOP,
+| from 'tt_esop', is already a PSDKRO.
+*-----------------------------------------------------------------------------*/
+void aig_extr_mngr::minimize(const std::uint32_t idx, node_stats &stats)
+{
+	using time = std::chrono::high_resolution_clock;
+	static constexpr std::size_t min_growth_size = 64u;
+	auto &esop = m_esops[idx];
+	std::size_t max_leaf = 0u;
+	for (auto l = 0u; l < n_leaves_of(idx); ++l)
+		max_leaf = std::max(max_leaf, m_esops[Abc_Lit2Var(m_leaves[idx][l])].size());
+	const auto by_size = m_params.exorcism_size > 0u
+	                     && esop.size() > m_params.exorcism_size;
+	const auto by_growth = m_params.exorcism_growth > 0.0 && !is_narrow(idx)
+	                       && esop.size() > min_growth_size
+	                       && esop.size() > m_params.exorcism_growth * max_leaf;
+	if (!by_size && !by_growth)
+		return;
+	auto start = time::now();
+	exorcism_params params;
+	params.resynthesis = m_params.exorcism_resynthesis;
+	params.max_iterations = m_params.exorcism_iterations;
+	stats.before = esop.size();
+	exorcism_mngr exor(esop, Gia_ManCiNum(m_aig), false, params);
+	esop = exor.run();
+	std::chrono::duration<double> duration = time::now() - start;
+	stats.exorcism_time = duration.count();
+}
+
+void aig_extr_mngr::collapse_co(const std::uint32_t idx, std::vector<std::vector<cube32>> &ret)
+{
+	using time = std::chrono::high_resolution_clock;
+	auto start = time::now();
+	auto obj = Gia_ManObj(m_aig, idx);
+	const auto driver = Gia_ObjFaninId0p(m_aig, obj);
+	auto &out = ret[Gia_ObjCioId(obj)];
+	if (m_co_refs[Gia_ObjCioId(obj)].first == (std::uint32_t) Gia_ObjCioId(obj))
+		esop_view(m_esops[driver], Gia_ObjFaninC0(obj)).copy_to(out);
+	release(driver);
+	std::chrono::duration<double> duration = time::now() - start;
+	if (_dlogger != nullptr) {
+		const auto co = m_cone_log != nullptr ? m_cone_log->cos[Gia_ObjCioId(obj)]
+		                                      : Gia_ObjCioId(obj);
+		_dlogger->info("{},{},-1,-1,{}", co, out.size(), duration.count());
+	}
+}
+
+void aig_extr_mngr::log_node(const std::uint32_t idx, const node_stats &stats)
+{
+	if (stats.exorcism_time >= 0.0) {
+		++m_n_minimized;
+		m_n_saved += stats.before - m_esops[idx].size();
+	}
+	if (_dlogger == nullptr)
+		return;
+	const auto id = m_cone_log != nullptr ? m_cone_log->nodes[idx] : idx;
+	_dlogger->info("{},{},{},{},{}", id, stats.size0, stats.size1,
+		       m_esops[idx].size(), stats.time);
+	if (stats.exorcism_time >= 0.0) {
+		_dlogger->info("# exorcism,{},{},{},{}", id, stats.before,
+			       m_esops[idx].size(), stats.exorcism_time);
+	}
+}
+
+/* View of the ESOP of a fanin literal, complemented in place */
+esop_view aig_extr_mngr::fanin(const std::uint32_t lit) const
+{
+	return esop_view(m_esops[Abc_Lit2Var(lit)], Abc_LitIsCompl(lit));
+}
+
+void aig_extr_mngr::compute_and(std::uint32_t index, scratch &ws, bool parallel)
+{
+	/* one of the children is 0 function */
+	if (ws.esop0.empty() || ws.esop1.empty())
+		return;
+	if (m_params.radix && parallel) {
+		parallel_and(index, ws);
+		return;
+	}
+	multiply(ws);
+	finish(index, ws);
+}
+
+/*------------------------------------------------------------------------------
+| XOR node: the ESOP of a XOR is the concatenation of the children ESOPs, with
+| common cubes cancelled.
+*-----------------------------------------------------------------------------*/
+void aig_extr_mngr::compute_xor(std::uint32_t index, scratch &ws)
+{
+	if (m_params.radix) {
+		auto append = [&](cube32 cube) { ws.products.push_back(cube); };
+		ws.esop0.for_each(append);
+		ws.esop1.for_each(append);
+	} else {
+		auto add = [&](cube32 cube) { add_cube(ws, cube); };
+		ws.esop0.for_each(add);
+		ws.esop1.for_each(add);
+	}
+	finish(index, ws);
+}
+
+/*------------------------------------------------------------------------------
+| MUX node: c ? t : e is the XOR of the disjoint products c.t and !c.e, each
+| much smaller than the products of the three AND nodes it replaces.
+*-----------------------------------------------------------------------------*/
+void aig_extr_mngr::compute_mux(std::uint32_t index, scratch &ws)
+{
+	const auto &leaves = m_leaves[index];
+	ws.esop0 = fanin(leaves[0]);
+	ws.esop1 = fanin(leaves[1]);
+	multiply(ws);
+	ws.esop0 = fanin(Abc_LitNot(leaves[0]));
+	ws.esop1 = fanin(leaves[2]);
+	multiply(ws);
+	finish(index, ws);
+}
+
+/*------------------------------------------------------------------------------
+| Accumulates the products of the cubes of 'esop0' and 'esop1' in the worker's
+| temporaries: a flat array in radix mode, the XOR set otherwise. Either way the
+| products are computed by the array kernel, the larger ESOP swept once per
+| cube of the other, so that a single-cube fanin is a single sweep; without
+| radix, each sweep is compacted in 'products' and then XORed into the set.
+*-----------------------------------------------------------------------------*/
+void aig_extr_mngr::multiply(scratch &ws)
+{
+	const auto swap = ws.esop0.size() > ws.esop1.size();
+	const auto &outer = swap ? ws.esop1 : ws.esop0;
+	const auto &inner = swap ? ws.esop0 : ws.esop1;
+	outer.for_each([&](cube32 cube) {
+		inner.multiply_into(cube, ws.products);
+		if (m_params.radix)
+			return;
+		for (const auto &product : ws.products)
+			add_cube(ws, product);
+		ws.products.clear();
+	});
+}
+
+/* Moves the accumulated cubes to the node's ESOP */
+void aig_extr_mngr::finish(std::uint32_t index, scratch &ws)
+{
+	if (m_params.radix) {
+		canonicalize(ws.products, m_params.merge);
+		m_esops[index].assign(ws.products.begin(), ws.products.end());
+		ws.products.clear();
+		return;
+	}
+	std::copy(ws.curr_esop.begin(), ws.curr_esop.end(), std::back_inserter(m_esops[index]));
+	ws.curr_esop.clear();
+}
+
+/*------------------------------------------------------------------------------
+| Parallel product of the radix mode. Each chunk of the first fanin ESOP is
+| multiplied into its own buffer, which is then sorted and cancelled. Buffers
+| are merged pairwise, cancelling across them, until one is left: as XOR
+| cancellation only depends on the parity of each cube, this gives the same
+| sorted and cancelled array as the serial path, and so does the merging.
+*-----------------------------------------------------------------------------*/
+void aig_extr_mngr::parallel_and(std::uint32_t index, scratch &ws)
+{
+	const auto &esop0 = ws.esop0;
+	const auto &esop1 = ws.esop1;
+	const auto n_chunks = std::min<std::size_t>(4u * m_pool->size(), esop0.size());
+	const auto chunk = (esop0.size() + n_chunks - 1) / n_chunks;
+	std::vector<std::vector<cube32>> buffers(n_chunks);
+	m_pool->parallel_for(n_chunks, [&](std::size_t c, std::uint32_t) {
+		auto &out = buffers[c];
+		const auto end = std::min(esop0.size(), (c + 1) * chunk);
+		for (auto i = c * chunk; i < end; ++i)
+			esop1.multiply_into(esop0[i], out);
+		radix_sort(out);
+		xor_cancel(out);
+	});
+	while (buffers.size() > 1) {
+		std::vector<std::vector<cube32>> merged((buffers.size() + 1) / 2);
+		m_pool->parallel_for(merged.size(), [&](std::size_t i, std::uint32_t) {
+			if (2 * i + 1 == buffers.size()) {
+				merged[i].swap(buffers[2 * i]);
+				return;
 			}
-			cube32 tmp = cube0 & cube1;
-			if (tmp != cube32_zero)
-				add_cube(tmp);
+			merge_cancel(buffers[2 * i], buffers[2 * i + 1], merged[i]);
+			std::vector<cube32>().swap(buffers[2 * i]);
+			std::vector<cube32>().swap(buffers[2 * i + 1]);
+		});
+		buffers.swap(merged);
+	}
+	auto &products = buffers.front();
+	if (m_params.merge && merge_neighbors(products) > 0u)
+		canonicalize(products, true);
+	m_esops[index].swap(products);
+}
+
+void aig_extr_mngr::add_cube(scratch &ws, cube32 cube0)
+{
+	ws.curr_esop.add(cube0);
+}
+
+/*------------------------------------------------------------------------------
+| Structural cone of a CO: the sorted indices of the CIs of its support, and its
+| AND nodes. 'stamps' marks the nodes visited, with 'stamp', which must be new
+| for each cone; nodes already marked with it, by the cones of other COs, are
+| left out.
+*-----------------------------------------------------------------------------*/
+static void co_cone(Gia_Man_t *aig, const std::uint32_t co, std::vector<std::uint32_t> &stamps,
+                    const std::uint32_t stamp, std::vector<std::uint32_t> &support,
+                    std::vector<std::uint32_t> &nodes)
+{
+	std::vector<std::uint32_t> stack = {
+		(std::uint32_t) Gia_ObjFaninId0p(aig, Gia_ManCo(aig, co))
+	};
+	support.clear();
+	nodes.clear();
+	while (!stack.empty()) {
+		const auto id = stack.back();
+		stack.pop_back();
+		if (stamps[id] == stamp)
+			continue;
+		stamps[id] = stamp;
+		auto obj = Gia_ManObj(aig, id);
+		if (Gia_ObjIsCi(obj)) {
+			support.push_back(Gia_ObjCioId(obj));
+		} else if (Gia_ObjIsAnd(obj)) {
+			nodes.push_back(id);
+			stack.push_back(Gia_ObjFaninId0(obj, id));
+			stack.push_back(Gia_ObjFaninId1(obj, id));
 		}
 	}
-	std::copy(m_curr_esop.begin(), m_curr_esop.end(), std::back_inserter(m_esops[index]));
-	m_curr_esop.clear();
+	std::sort(support.begin(), support.end());
 }
 
-void aig_extr_mngr::add_cube(cube32 cube0)
+/*------------------------------------------------------------------------------
+| Partitioned collapsing: COs are collapsed by groups, each from the cones of
+| its COs duplicated with the CIs of their support only, by 'collapse'. An AIG
+| of any number of CIs fits cube32 as long as the support of each group does,
+| the cubes of each output being over the support of its group, see
+| 'two_lvl32'. COs of the same driver are collapsed once.
+|
+| Groups are formed greedily, in CO order: a CO joins the group owning most of
+| the nodes of its cone, unless the group would exceed 'partition_size' nodes
+| or 32 support variables, and starts a new group otherwise. Cones sharing
+| logic are so collapsed together, once, while independent ones are apart.
+| With 'n_threads' > 1, groups are collapsed concurrently, one per thread; a
+| single group gets all the threads. The data of each group is buffered, with
+| the ids of 'aig', and logged in group order once all are collapsed.
+*-----------------------------------------------------------------------------*/
+two_lvl32 collapse_cones(Gia_Man_t *aig, bool verbose, const aig_extr_params &params,
+                         const cone_collapser &collapse)
 {
-	auto cont = 0;
-	do {
-		cont = 0;
-		if (m_curr_esop.erase(cube0))
-			return;
-		if (cube0 == cube32_one) {
-			m_curr_esop.insert(cube0);
-			return;
+	struct cone_group {
+		std::vector<int> cos;
+		std::vector<std::uint32_t> support;
+		std::size_t n_nodes;
+	};
+	std::uint32_t i;
+	Gia_Obj_t *obj;
+	const std::uint32_t n_cos = Gia_ManCoNum(aig);
+	std::vector<std::uint32_t> stamps(Gia_ManObjNum(aig), 0u);
+	std::vector<std::uint32_t> first_co(Gia_ManObjNum(aig), n_cos);
+	std::vector<std::uint32_t> owner(Gia_ManObjNum(aig), n_cos);
+	std::vector<std::uint32_t> support, nodes, merged;
+	std::unordered_map<std::uint32_t, std::size_t> shared;
+	std::vector<cone_group> groups;
+
+	two_lvl32 ret;
+	ret._kind = two_lvl32::kind_t::ESOP;
+	ret._n_inputs = Gia_ManCiNum(aig);
+	ret._cubes.resize(n_cos);
+	ret._refs.resize(n_cos);
+	ret._supports.resize(n_cos);
+	Gia_ManForEachCo(aig, obj, i) {
+		auto &first = first_co[Gia_ObjFaninId0p(aig, obj)];
+		if (first != n_cos) {
+			ret._refs[i] = {first, Gia_ObjFaninC0(obj)
+			                       != Gia_ObjFaninC0(Gia_ManCo(aig, first))};
+			continue;
 		}
-		for (auto i = 0; i < Gia_ManCiNum(m_aig); ++i) {
-			auto cube1 = cube0;
-			cube1.rotate(i);
-			auto c_tmp = m_curr_esop.find(cube1);
-			if (c_tmp != m_curr_esop.end()) {
-				cube0 = merge(cube0, *c_tmp);
-				m_curr_esop.erase(c_tmp);
-				cont = 1;
-				break;
-			}
-			cube1.rotate(i);
-			c_tmp = m_curr_esop.find(cube1);
-			if (c_tmp != m_curr_esop.end()) {
-				cube0 = merge(cube0, *c_tmp);
-				m_curr_esop.erase(c_tmp);
-				cont = 1;
-				break;
-			}
+		first = i;
+		ret._refs[i] = {i, false};
+		co_cone(aig, i, stamps, i + 1u, support, nodes);
+		if (support.size() > 32u) {
+			spdlog::get("console")
+				->info("Cannot handle outputs of more than 32 support variables");
+			exit(0);
 		}
-	} while (cont);
-	m_curr_esop.insert(cube0);
+		shared.clear();
+		for (const auto id : nodes) {
+			if (owner[id] != n_cos)
+				++shared[owner[id]];
+		}
+		std::uint32_t best = groups.size();
+		std::size_t best_shared = 0u;
+		for (const auto &s : shared) {
+			const auto &group = groups[s.first];
+			if (s.second < best_shared || (s.second == best_shared && s.first > best))
+				continue;
+			if (group.n_nodes + nodes.size() - s.second > params.partition_size)
+				continue;
+			merged.clear();
+			std::set_union(group.support.begin(), group.support.end(),
+			               support.begin(), support.end(), std::back_inserter(merged));
+			if (merged.size() > 32u)
+				continue;
+			best = s.first;
+			best_shared = s.second;
+		}
+		if (best == groups.size())
+			groups.push_back({{}, {}, 0u});
+		auto &group = groups[best];
+		group.cos.push_back(i);
+		merged.clear();
+		std::set_union(group.support.begin(), group.support.end(),
+		               support.begin(), support.end(), std::back_inserter(merged));
+		group.support.swap(merged);
+		group.n_nodes += nodes.size() - best_shared;
+		for (const auto id : nodes) {
+			if (owner[id] == n_cos)
+				owner[id] = best;
+		}
+	}
+
+	/* Cones are duplicated upfront, as duplicating marks the nodes of 'aig'
+	 * with their copies, which the data log maps back right after */
+	auto dlogger = spdlog::get("data");
+	std::vector<Gia_Man_t *> cones;
+	std::vector<cone_log> logs(groups.size());
+	std::vector<std::ostringstream> buffers(groups.size());
+	for (auto g = 0u; g < groups.size(); ++g) {
+		auto &group = groups[g];
+		cones.push_back(Gia_ManDupCones(aig, group.cos.data(), group.cos.size(), 1));
+		if (dlogger == nullptr)
+			continue;
+		auto &log = logs[g];
+		log.cos = group.cos;
+		log.nodes.assign(Gia_ManObjNum(cones[g]), 0u);
+		for (const auto co : group.cos) {
+			co_cone(aig, co, stamps, n_cos + 1u + g, support, nodes);
+			for (const auto id : nodes)
+				log.nodes[Abc_Lit2Var(Gia_ManObj(aig, id)->Value)] = id;
+		}
+		log.logger = std::make_shared<spdlog::logger>(
+			"data", std::make_shared<spdlog::sinks::ostream_sink_mt>(buffers[g]));
+		log.logger->set_pattern("%v");
+		log.logger->set_level(dlogger->level());
+	}
+	std::vector<two_lvl32> results(groups.size());
+	if (params.n_threads > 1 && groups.size() > 1) {
+		thread_pool pool(params.n_threads);
+		pool.parallel_for(groups.size(), [&](std::size_t g, std::uint32_t) {
+			results[g] = collapse(cones[g], 1u, logs[g]);
+		});
+	} else {
+		for (auto g = 0u; g < groups.size(); ++g)
+			results[g] = collapse(cones[g], params.n_threads, logs[g]);
+	}
+
+	if (dlogger != nullptr) {
+		for (auto g = 0u; g < groups.size(); ++g) {
+			dlogger->info("# group {}: {} COs, {} CIs", g, groups[g].cos.size(),
+			              groups[g].support.size());
+			std::istringstream lines(buffers[g].str());
+			std::string line;
+			while (std::getline(lines, line))
+				dlogger->info("{}", line);
+		}
+	}
+
+	std::size_t max_support = 0u;
+	for (auto g = 0u; g < groups.size(); ++g) {
+		for (auto j = 0u; j < groups[g].cos.size(); ++j) {
+			const auto co = groups[g].cos[j];
+			ret._cubes[co] = results[g].cubes_of(j);
+			ret._supports[co] = groups[g].support;
+		}
+		max_support = std::max(max_support, groups[g].support.size());
+		Gia_ManStop(cones[g]);
+	}
+	spdlog::get("console")->info_if(verbose, "Collapsed {} groups of cones of at most {} variables",
+	                                groups.size(), max_support);
+	return ret;
+}
+
+two_lvl32 aig_extract_cones(Gia_Man_t *aig, bool verbose, const aig_extr_params &params)
+{
+	return collapse_cones(aig, verbose, params, [&params](Gia_Man_t *cone, std::uint32_t n_threads,
+	                                                      const cone_log &log) {
+		auto cone_params = params;
+		cone_params.n_threads = n_threads;
+		aig_extr_mngr mngr(cone, cone_params);
+		mngr.log_to(log);
+		return mngr.run(false);
+	});
 }
 
 } // namespace lsy
@@ -5,7 +5,10 @@
 #ifndef LOSYS_AIG_COLLAPSE_H
 #define LOSYS_AIG_COLLAPSE_H
 
+#include <array>
 #include <chrono>
+#include <functional>
+#include <memory>
 #include <unordered_set>
 #include <vector>
 
@@ -17,48 +20,285 @@ extern "C" {
 
 #include "kernel/cube32.hpp"
 #include "kernel/two_lvl32.hpp"
+#include "kernel/xor_set32.hpp"
+#include "utils/thread_pool.hpp"
 
 namespace lsy {
 
+/*------------------------------------------------------------------------------
+| AIG Extract parameters
+|
+| By default the products of an AND node are XORed one by one into a hash set,
+| which cancels duplicates and merges cubes at distance 1 as they come. With
+| 'radix', the products are appended to a flat array instead, radix sorted and
+| cancelled in bulk, 'merge' adding sweeps of distance-1 neighbor merging.
+|
+| With 'n_threads' > 1, the AIG is levelized and the nodes of each level are
+| collapsed concurrently. In radix mode, nodes with at least 'parallel_product'
+| products are instead computed one at a time, each by all threads: the first
+| fanin ESOP is split into chunks, whose products are canonicalized separately
+| and then merged pairwise. The result is the same as the serial one.
+|
+| With 'xor_mux', XOR and MUX structures are collapsed as such: a XOR as the
+| concatenation of its inputs' ESOPs, a MUX as two products.
+|
+| Intermediate ESOPs are minimized by exorcism, bounded to 'exorcism_iterations'
+| iterations, when they have more than 'exorcism_size' cubes or grow more than
+| 'exorcism_growth' times over their largest fanin ESOP (0 disables either),
+| with windowed exact resynthesis when 'exorcism_resynthesis'.
+|
+| Nodes with a structural support of at most 'tt_support' variables (up to 16,
+| 0 disables) are collapsed through truth tables, see 'collapse_tt'.
+|
+| Wider nodes whose cone has at most 'memo_cone' nodes (0 disables) are
+| memoized structurally: a node whose cone is isomorphic to the cone of a node
+| collapsed before takes that node's ESOP, with its variables renamed.
+|
+| With 'partition', or always beyond 32 CIs, COs are collapsed by groups, each
+| from its own duplicated cone and manager, see 'collapse_cones'. Cones
+| sharing logic are grouped up to 'partition_size' nodes per group. The BDD
+| method partitions alike, see 'bdd_extract_cones'.
+*-----------------------------------------------------------------------------*/
+struct aig_extr_params {
+	bool radix = false;
+	bool merge = true;
+	std::uint32_t n_threads = 1u;
+	std::uint64_t parallel_product = 1ull << 22;
+	bool xor_mux = true;
+	std::uint32_t exorcism_size = 0u;
+	double exorcism_growth = 0.0;
+	std::uint32_t exorcism_iterations = 1u;
+	bool exorcism_resynthesis = false;
+	std::uint32_t tt_support = 10u;
+	std::uint32_t memo_cone = 32u;
+	bool partition = false;
+	std::uint32_t partition_size = 4096u;
+};
+
+/*------------------------------------------------------------------------------
+| Fanin view
+| ------
+| TLDR: read-only view of a fanin ESOP, complemented or not, without copy.
+|
+| The complement of an ESOP is its XOR with the constant one: the view either
+| skips the leading constant-one cube of the ESOP, or puts a virtual cube in
+| front of it, the constant one or, for a leading single-literal cube, that
+| cube inverted (x ^ 1 = !x) while skipping the original. ESOPs of the manager
+| keep their constant-one cube first for this to hold.
+*-----------------------------------------------------------------------------*/
+class esop_view {
+public:
+	esop_view() = default;
+
+	esop_view(const std::vector<cube32> &esop, const bool cmpl)
+	: m_first(esop.data()), m_last(esop.data() + esop.size())
+	{
+		if (!cmpl)
+			return;
+		m_has_lead = true;
+		m_lead = cube32_one;
+		if (esop.empty())
+			return;
+		if (esop.front() == cube32_one) {
+			m_has_lead = false;
+			++m_first;
+		} else if (esop.front().n_lits() == 1) {
+			m_lead = esop.front();
+			m_lead.invert();
+			++m_first;
+		}
+	}
+
+	std::size_t size() const
+	{ return (m_last - m_first) + m_has_lead; }
+
+	bool empty() const
+	{ return size() == 0u; }
+
+	cube32 operator[](const std::size_t i) const
+	{
+		if (m_has_lead)
+			return i == 0u ? m_lead : m_first[i - 1];
+		return m_first[i];
+	}
+
+	template<typename Fn>
+	void for_each(Fn &&fn) const
+	{
+		if (m_has_lead)
+			fn(m_lead);
+		for (auto it = m_first; it != m_last; ++it)
+			fn(*it);
+	}
+
+	/* Appends the non-empty products of 'cube' with the cubes of the view */
+	void multiply_into(const cube32 cube, std::vector<cube32> &out) const
+	{
+		if (cube == cube32_one) {
+			if (m_has_lead)
+				out.push_back(m_lead);
+			out.insert(out.end(), m_first, m_last);
+			return;
+		}
+		if (m_has_lead) {
+			const auto tmp = cube & m_lead;
+			if (tmp != cube32_zero)
+				out.push_back(tmp);
+		}
+		const auto n = out.size();
+		out.resize(n + (m_last - m_first));
+		out.resize(n + and_compact(cube, m_first, m_last, out.data() + n));
+	}
+
+	void copy_to(std::vector<cube32> &out) const
+	{
+		out.clear();
+		out.reserve(size());
+		if (m_has_lead)
+			out.push_back(m_lead);
+		out.insert(out.end(), m_first, m_last);
+	}
+
+private:
+	const cube32 *m_first = nullptr;
+	const cube32 *m_last = nullptr;
+	cube32 m_lead;
+	bool m_has_lead = false;
+};
+
+/*------------------------------------------------------------------------------
+| Data log of a group of cones, see 'collapse_cones': the ids, in the AIG
+| partitioned, of the COs and AND nodes of the AIG of the group, and the logger
+| its lines are buffered in (null if no data is logged).
+*-----------------------------------------------------------------------------*/
+struct cone_log {
+	std::vector<int> cos;
+	std::vector<std::uint32_t> nodes;
+	std::shared_ptr<spdlog::logger> logger;
+};
+
 /*------------------------------------------------------------------------------
 | AIG Extract manager
 *-----------------------------------------------------------------------------*/
 class aig_extr_mngr {
 public:
-	aig_extr_mngr(Gia_Man_t *);
+	aig_extr_mngr(Gia_Man_t *, const aig_extr_params & = {});
 	two_lvl32 run(bool);
+	void log_to(const cone_log &);
 
 private:
-	void prepare_input(const std::uint32_t, std::uint32_t,
-	                   std::vector<cube32> &);
-	void compute_and(const std::uint32_t);
-	void compute_xor(const std::uint32_t);
-	void add_cube(cube32);
+	/* Per-worker temporaries */
+	struct scratch {
+		explicit scratch(const std::uint32_t n_vars)
+		: curr_esop(n_vars)
+		{ }
+
+		esop_view esop0;
+		esop_view esop1;
+		xor_set32 curr_esop;
+		std::vector<cube32> products;
+	};
+	enum node_type : std::uint8_t {
+		NODE_AND,
+		NODE_XOR,
+		NODE_MUX
+	};
+	struct node_stats {
+		std::size_t size0;
+		std::size_t size1;
+		double time;
+		/* Size before exorcism, and its time (negative if none ran) */
+		std::size_t before;
+		double exorcism_time;
+	};
+
+	void recognize();
+	void schedule();
+	void compute_supports();
+	void find_twins();
+	bool cone_key(const std::uint32_t, std::vector<std::uint32_t> &,
+	              std::vector<std::uint32_t> &, std::vector<std::uint8_t> &) const;
+	std::uint32_t n_leaves_of(const std::uint32_t) const;
+	bool is_narrow(const std::uint32_t) const;
+	void run_serial(std::vector<std::vector<cube32>> &, bool);
+	void run_levels(std::vector<std::vector<cube32>> &, bool);
+	node_stats collapse_node(const std::uint32_t, scratch &, bool = false);
+	bool is_huge(const std::uint32_t) const;
+	void collapse_co(const std::uint32_t, std::vector<std::vector<cube32>> &);
+	void collapse_tt(const std::uint32_t);
+	void instantiate(const std::uint32_t);
+	void minimize(const std::uint32_t, node_stats &);
+	void log_node(const std::uint32_t, const node_stats &);
+	void acquire(const std::uint32_t);
+	void release(const std::uint32_t);
+	void release_leaves(const std::uint32_t);
+	esop_view fanin(const std::uint32_t) const;
+	void compute_and(const std::uint32_t, scratch &, bool);
+	void parallel_and(const std::uint32_t, scratch &);
+	void compute_xor(const std::uint32_t, scratch &);
+	void compute_mux(const std::uint32_t, scratch &);
+	void multiply(scratch &);
+	void finish(const std::uint32_t, scratch &);
+	void add_cube(scratch &, cube32);
 	void debug() const;
 
 private:
 	/* Loggers (Console, Data) */
 	std::shared_ptr<spdlog::logger> _clogger;
 	std::shared_ptr<spdlog::logger> _dlogger;
+	/* Ids the data is logged with, when collapsing a group of cones */
+	const cone_log *m_cone_log = nullptr;
 
 	Gia_Man_t *m_aig;
+	aig_extr_params m_params;
 	std::vector<std::vector<cube32>> m_esops;
-	/* Temporary */
-	std::vector<cube32> m_esop0;
-	std::vector<cube32> m_esop1;
-	std::unordered_set<cube32, cube32_hash> m_curr_esop;
+	/* Node types and leaves (as literals), nodes collapsed per type */
+	std::vector<node_type> m_types;
+	std::vector<std::array<std::uint32_t, 3>> m_leaves;
+	std::array<std::uint32_t, 3> m_n_nodes;
+	/* Structural supports, truth tables of the narrow nodes */
+	std::vector<std::uint32_t> m_supports;
+	std::vector<std::uint8_t> m_needs_esop;
+	std::vector<std::vector<std::uint64_t>> m_tts;
+	/* Memoized nodes: the earlier node of isomorphic cone (0 if none), and
+	 * the CIs of the cones, in the order of their key's traversal */
+	std::vector<std::uint32_t> m_twins;
+	std::vector<std::vector<std::uint8_t>> m_cone_vars;
+	std::uint32_t m_n_twins;
+	/* Collapse order, fanout references and memory bookkeeping */
+	std::vector<std::uint32_t> m_order;
+	std::vector<std::uint32_t> m_refs;
+	std::vector<std::pair<std::uint32_t, bool>> m_co_refs;
+	std::size_t m_live_cubes;
+	std::size_t m_peak_cubes;
+	/* Intermediate minimization */
+	std::uint32_t m_n_minimized;
+	std::size_t m_n_saved;
+	/* Workers and their temporaries */
+	std::unique_ptr<thread_pool> m_pool;
+	std::vector<scratch> m_scratch;
 };
 
-static two_lvl32 aig_extract(Gia_Man_t *aig, bool verbose)
+/*------------------------------------------------------------------------------
+| Partitioned collapsing, see 'collapse_cones'. A collapser returns the outputs
+| of the AIG of a group of cones, whose CIs are the support of the group, using
+| the given number of threads, and logs its data to the group's 'cone_log'.
+*-----------------------------------------------------------------------------*/
+using cone_collapser = std::function<two_lvl32(Gia_Man_t *, std::uint32_t, const cone_log &)>;
+two_lvl32 collapse_cones(Gia_Man_t *, bool, const aig_extr_params &, const cone_collapser &);
+two_lvl32 aig_extract_cones(Gia_Man_t *, bool, const aig_extr_params &);
+
+static two_lvl32 aig_extract(Gia_Man_t *aig, bool verbose,
+                             const aig_extr_params &params = {})
 {
-	if (Gia_ManCiNum(aig) > 32) {
-		spdlog::get("console")
-			->info("Cannot handle more than 32 input variables");
-		exit(0);
-	}
-	aig_extr_mngr mngr(aig);
 	auto start = std::chrono::high_resolution_clock::now();
-	auto ret = mngr.run(verbose);
+	two_lvl32 ret;
+	if (Gia_ManCiNum(aig) > 32 || params.partition) {
+		ret = aig_extract_cones(aig, verbose, params);
+	} else {
+		aig_extr_mngr mngr(aig, params);
+		ret = mngr.run(verbose);
+	}
 	std::chrono::duration<double> aig2esop_time =
 		std::chrono::high_resolution_clock::now() - start;
 	printf("[i] Elapsed time: %f\n",  aig2esop_time.count());
@@ -2,8 +2,11 @@
 | This file is distributed under the BSD 2-Clause License.
 | See LICENSE for details.
 *-----------------------------------------------------------------------------*/
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <map>
+#include <numeric>
 #include <vector>
 #include <unordered_set>
 #include <utility> /* std::pair */
@@ -15,154 +18,274 @@ extern "C" {
 
 #include "bdd/collapse.hpp"
 #include "kernel/cube32.hpp"
+#include "xforms/xforms.hpp"
 
 namespace lsy {
 
+/* Suspends CUDD's automatic reordering for the lifetime of the object */
+class reordering_pause {
+public:
+	explicit reordering_pause(DdManager *cudd)
+	: m_cudd(cudd)
+	{
+		m_enabled = Cudd_ReorderingStatus(cudd, &m_method);
+		if (m_enabled)
+			Cudd_AutodynDisable(cudd);
+	}
+
+	~reordering_pause()
+	{
+		if (m_enabled)
+			Cudd_AutodynEnable(m_cudd, m_method);
+	}
+
+private:
+	DdManager *m_cudd;
+	Cudd_ReorderingType m_method;
+	int m_enabled;
+};
+
 psdkro::psdkro(DdManager *cudd, uint32_t size)
-	: m_cudd(cudd), m_var_values(size, UNUSED)
-{ }
+	: m_cudd(cudd), m_positions(size),
+	  m_n_gcs(Cudd_ReadGarbageCollections(cudd)),
+	  m_n_reorders(Cudd_ReadReorderings(cudd))
+{
+	std::iota(m_positions.begin(), m_positions.end(), 0u);
+}
+
+/* Extraction over 'support', whose variables become cube variables 0..k-1 */
+std::vector<cube32> psdkro::extract_esop(DdNode *f, const std::vector<std::uint32_t> &support)
+{
+	std::vector<cube32> ret;
+	extract_esop(f, support, [&ret](const cube32 *cubes, std::size_t n) {
+		ret.insert(ret.end(), cubes, cubes + n);
+	});
+	return ret;
+}
 
 std::vector<cube32> psdkro::extract_esop(DdNode *f)
 {
-	if (f == NULL)
-		return {};
-	m_exp_costs.clear();
-	m_esop.clear();
-	std::fill(m_var_values.begin(), m_var_values.end(), UNUSED);
-	count_cubes(f);
-	generate_exact(f);
 	std::vector<cube32> ret;
-	std::copy(m_esop.begin(), m_esop.end(), std::back_inserter(ret));
+	extract_esop(f, [&ret](const cube32 *cubes, std::size_t n) {
+		ret.insert(ret.end(), cubes, cubes + n);
+	});
 	return ret;
 }
 
-void psdkro::add_cube(const cube32 c)
+void psdkro::extract_esop(DdNode *f, const std::vector<std::uint32_t> &support,
+                          const cube_sink &sink)
 {
-	auto c1 = c;
-	auto cont = 0;
-	do {
-		cont=0;
-		uint32_t tmp = m_esop.erase(c1);
-		if (tmp) {
-			return;
-		}
+	assert(support.size() <= 32u);
+	for (auto j = 0u; j < support.size(); ++j)
+		m_positions[support[j]] = j;
+	extract_esop(f, sink);
+}
 
-		if (c1 == cube32_one) {
-			m_esop.insert(c1);
-			return;
-		}
+void psdkro::extract_esop(DdNode *f, const cube_sink &sink)
+{
+	if (f == NULL)
+		return;
+	reordering_pause pause(m_cudd);
+	sync_costs();
+	count_cubes(f);
+	cube32_batch batch(sink, batch_size);
+	generate_exact(f, cube32_one, batch);
+	batch.flush();
+	release_xors();
+}
 
-		for (uint32_t i = 0; i < m_var_values.size(); ++i) {
-			auto c2 = c1;
-			c2.rotate(i);
-			auto c_tmp = m_esop.find(c2);
-			if (c_tmp != m_esop.end() && *c_tmp == c2) {
-				c1 = merge(c1, *c_tmp);
-				m_esop.erase(c_tmp);
-				cont=1;
-				break;
-			}
-			c2.rotate(i);
-			c_tmp = m_esop.find(c2);
-			if (c_tmp != m_esop.end() && *c_tmp == c2) {
-				c1 = merge(c1, *c_tmp);
-				m_esop.erase(c_tmp);
-				cont=1;
-				break;
-			}
-		}
-	} while (cont);
-	m_esop.insert(c1);
+/* Number of cubes 'extract_esop' would generate */
+std::uint64_t psdkro::count_esop(DdNode *f)
+{
+	if (f == NULL)
+		return 0u;
+	reordering_pause pause(m_cudd);
+	sync_costs();
+	const auto n_cubes = count_cubes(f).second;
+	release_xors();
+	return n_cubes;
 }
 
-void psdkro::generate_exact(DdNode *f)
+/* Drops the cost cache if CUDD collected garbage or reordered since */
+void psdkro::sync_costs()
 {
-	/* Terminal cases */
-	if (f == Cudd_ReadLogicZero(m_cudd))
-		return;
-	if (f == Cudd_ReadOne(m_cudd)) {
-		cube32 cube(0u);
-		for (auto var : m_vars) {
-			cube.mask |= ((m_var_values[var] != UNUSED) << var);
-			cube.polarity |= ((m_var_values[var] == POSITIVE) << var);
-		}
-		// add_cube(cube);
-		m_esop.insert(cube);
+	const auto n_gcs = Cudd_ReadGarbageCollections(m_cudd);
+	const auto n_reorders = Cudd_ReadReorderings(m_cudd);
+	if (n_gcs == m_n_gcs && n_reorders == m_n_reorders)
 		return;
+	m_exp_costs.clear();
+	m_n_gcs = n_gcs;
+	m_n_reorders = n_reorders;
+}
+
+const std::pair<psdkro::exp_type, std::uint64_t> *psdkro::find_cost(DdNode *f) const
+{
+	auto it = m_exp_costs.find(Cudd_Regular(f));
+	if (it == m_exp_costs.end() || !it->second.known[Cudd_IsComplement(f)])
+		return nullptr;
+	return &it->second.costs[Cudd_IsComplement(f)];
+}
+
+/* XOR of the cofactors of 'f', which is the same for both polarities */
+DdNode *psdkro::cofactors_xor(DdNode *f)
+{
+	DdNode *node = Cudd_Regular(f);
+	auto &f2 = m_xors[node];
+	if (f2 != nullptr) {
+		++m_stats.n_reused;
+		return f2;
 	}
-	/* Find the best expansion by a cache lookup */
-	assert(m_exp_costs.find(f) != m_exp_costs.end());
-	exp_type expension = m_exp_costs[f].first;
-
-	/* Determine the top-most variable */
-	auto idx = Cudd_NodeReadIndex(f);
-	m_vars.push_back(idx);
-
-	/* Determine cofactors */
-	DdNode *f0 = Cudd_NotCond(Cudd_E(f), Cudd_IsComplement(f));
-	DdNode *f1 = Cudd_NotCond(Cudd_T(f), Cudd_IsComplement(f));
-	DdNode *f2 = Cudd_bddXor(m_cudd, f0, f1);
+	auto start = std::chrono::high_resolution_clock::now();
+	f2 = Cudd_bddXor(m_cudd, Cudd_E(node), Cudd_T(node));
 	Cudd_Ref(f2);
+	/* The only place, within an extraction, where CUDD may collect garbage */
+	sync_costs();
+	std::chrono::duration<double> xor_time =
+		std::chrono::high_resolution_clock::now() - start;
+	m_stats.seconds += xor_time.count();
+	++m_stats.n_computed;
+	return f2;
+}
 
-	/* Generate cubes in the left/right branches */
-	if (expension == POSITIVE_DAVIO) {
-		m_var_values[idx] = UNUSED;
-		generate_exact(f0);
-		m_var_values[idx] = POSITIVE;
-		generate_exact(f2);
-	} else if (expension == NEGATIVE_DAVIO) {
-		m_var_values[idx] = UNUSED;
-		generate_exact(f1);
-		m_var_values[idx] = NEGATIVE;
-		generate_exact(f2);
-	} else { /* SHANNON */
-		m_var_values[idx] = NEGATIVE;
-		generate_exact(f0);
-		m_var_values[idx] = POSITIVE;
-		generate_exact(f1);
-	}
-	m_vars.pop_back();
-	m_var_values[idx] = UNUSED;
-	Cudd_RecursiveDeref(m_cudd, f2);
+void psdkro::release_xors()
+{
+	for (auto &entry : m_xors)
+		Cudd_RecursiveDeref(m_cudd, entry.second);
+	m_xors.clear();
 }
 
-/* Recursive function */
-std::pair<psdkro::exp_type, std::uint32_t> psdkro::count_cubes(DdNode *f)
+/* Generates the cubes of 'f', each in the product with 'cube' */
+void psdkro::generate_exact(DdNode *f, cube32 cube, cube32_batch &batch)
 {
-	/* Check for terminal cases */
-	if (f == Cudd_ReadLogicZero(m_cudd))
-		return std::make_pair(POSITIVE_DAVIO, 0u);
-	if (f == Cudd_ReadOne(m_cudd))
-		return std::make_pair(POSITIVE_DAVIO, 1u);
-	auto it = m_exp_costs.find(f);
-	if (it != m_exp_costs.end()) {
-		return it->second;
+	DdNode *const zero = Cudd_ReadLogicZero(m_cudd);
+	DdNode *const one = Cudd_ReadOne(m_cudd);
+	std::vector<std::pair<DdNode *, cube32>> stack{{f, cube}};
+	while (!stack.empty()) {
+		const auto node = stack.back().first;
+		const auto path = stack.back().second;
+		stack.pop_back();
+
+		/* Terminal cases */
+		if (node == zero)
+			continue;
+		if (node == one) {
+			batch.push(path);
+			continue;
+		}
+		/* Find the best expansion by a cache lookup, costing it if missing */
+		const auto cost = find_cost(node);
+		const auto expansion = cost != nullptr ? cost->first : count_cubes(node).first;
+
+		/* Determine the top-most variable and cofactors */
+		const auto var = m_positions[Cudd_NodeReadIndex(node)];
+		DdNode *f0 = Cudd_NotCond(Cudd_E(node), Cudd_IsComplement(node));
+		DdNode *f1 = Cudd_NotCond(Cudd_T(node), Cudd_IsComplement(node));
+		auto neg = path;
+		auto pos = path;
+		neg.add_lit(var, 0u);
+		pos.add_lit(var, 1u);
+
+		/* The left branch is pushed last, to be generated first */
+		if (expansion == POSITIVE_DAVIO) {
+			stack.emplace_back(cofactors_xor(node), pos);
+			stack.emplace_back(f0, path);
+		} else if (expansion == NEGATIVE_DAVIO) {
+			stack.emplace_back(cofactors_xor(node), neg);
+			stack.emplace_back(f1, path);
+		} else { /* SHANNON */
+			stack.emplace_back(f1, pos);
+			stack.emplace_back(f0, neg);
+		}
 	}
+}
 
-	/* Determine cofactors */
-	DdNode *f0 = Cudd_NotCond(Cudd_E(f), Cudd_IsComplement(f));
-	DdNode *f1 = Cudd_NotCond(Cudd_T(f), Cudd_IsComplement(f));
-	DdNode *f2 = Cudd_bddXor(m_cudd, f0, f1);
-	Cudd_Ref(f2);
+/* Costs 'f' and its uncosted descendants, the children before the parents */
+std::pair<psdkro::exp_type, std::uint64_t> psdkro::count_cubes(DdNode *f)
+{
+	DdNode *const zero = Cudd_ReadLogicZero(m_cudd);
+	DdNode *const one = Cudd_ReadOne(m_cudd);
+	const std::pair<exp_type, std::uint64_t> zero_cost(POSITIVE_DAVIO, 0u);
+	const std::pair<exp_type, std::uint64_t> one_cost(POSITIVE_DAVIO, 1u);
+	auto cost_of = [&](DdNode *node) {
+		if (node == zero)
+			return &zero_cost;
+		if (node == one)
+			return &one_cost;
+		return find_cost(node);
+	};
+
+	/* A node is pushed with no XOR, and gets it when first visited. It stays
+	 * until its children are costed, which a garbage collection may undo */
+	std::vector<std::pair<DdNode *, DdNode *>> stack{{f, nullptr}};
+	while (!stack.empty()) {
+		const auto node = stack.back().first;
+		if (cost_of(node) != nullptr) {
+			stack.pop_back();
+			continue;
+		}
+		/* Determine cofactors */
+		DdNode *f0 = Cudd_NotCond(Cudd_E(node), Cudd_IsComplement(node));
+		DdNode *f1 = Cudd_NotCond(Cudd_T(node), Cudd_IsComplement(node));
+		if (stack.back().second == nullptr)
+			stack.back().second = cofactors_xor(node);
+		DdNode *f2 = stack.back().second;
+		auto uncosted = false;
+		for (auto child : {f0, f1, f2}) {
+			if (cost_of(child) == nullptr) {
+				stack.emplace_back(child, nullptr);
+				uncosted = true;
+			}
+		}
+		if (uncosted)
+			continue;
+		stack.pop_back();
+
+		/* Subproblems are solved */
+		std::uint64_t n0 = cost_of(f0)->second;
+		std::uint64_t n1 = cost_of(f1)->second;
+		std::uint64_t n2 = cost_of(f2)->second;
 
-	/* Recursively solve subproblems */
-	std::uint32_t n0 = count_cubes(f0).second;
-	std::uint32_t n1 = count_cubes(f1).second;
-	std::uint32_t n2 = count_cubes(f2).second;
-
-	/* Determine the mostly costly expansion */
-	std::uint32_t n_max = std::max(std::max(n0, n1), n2);
-
-	/* Choose the least costly expansion */
-	std::pair<exp_type, std::uint32_t> ret;
-	if (n_max == n0) {
-		ret = std::make_pair(NEGATIVE_DAVIO, n1 + n2);
-	} else if (n_max == n1) {
-		ret = std::make_pair(POSITIVE_DAVIO, n0 + n2);
-	} else {
-		ret = std::make_pair(SHANNON, n0 + n1);
+		/* Determine the mostly costly expansion */
+		std::uint64_t n_max = std::max(std::max(n0, n1), n2);
+
+		/* Choose the least costly expansion */
+		std::pair<exp_type, std::uint64_t> ret;
+		if (n_max == n0) {
+			ret = std::make_pair(NEGATIVE_DAVIO, n1 + n2);
+		} else if (n_max == n1) {
+			ret = std::make_pair(POSITIVE_DAVIO, n0 + n2);
+		} else {
+			ret = std::make_pair(SHANNON, n0 + n1);
+		}
+		auto &entry = m_exp_costs[Cudd_Regular(node)];
+		entry.costs[Cudd_IsComplement(node)] = ret;
+		entry.known[Cudd_IsComplement(node)] = true;
 	}
-	m_exp_costs[f] = ret;
+	return *cost_of(f);
+}
+
+/*------------------------------------------------------------------------------
+| Partitioned collapsing using BDD: each group of cones, see 'collapse_cones',
+| is converted by a CUDD manager of its own, whose variables are the support of
+| the group, so groups are collapsed concurrently with 'n_threads' > 1.
+*-----------------------------------------------------------------------------*/
+two_lvl32 bdd_extract_cones(Gia_Man_t *aig, bool reorder, bool verbose,
+                            const aig_extr_params &params)
+{
+	printf("[i] Collapsing using BDD (partitioned)\n");
+	auto start = std::chrono::high_resolution_clock::now();
+	auto ret = collapse_cones(aig, verbose, params, [reorder](Gia_Man_t *cone, std::uint32_t,
+	                                                         const cone_log &) {
+		auto bdd = aig_to_bdd(cone, reorder, 0);
+		psdkro mngr(bdd.first.getManager(), bdd.first.ReadSize());
+		std::vector<std::vector<cube32>> fncts;
+		for (auto &f : bdd.second)
+			fncts.push_back(mngr.extract_esop(f.getNode()));
+		return two_lvl32{two_lvl32::kind_t::ESOP, (std::uint32_t) Gia_ManCiNum(cone), fncts};
+	});
+	std::chrono::duration<double> bdd2esop_time =
+		std::chrono::high_resolution_clock::now() - start;
+	printf("[i] Elapsed time: %f\n",  bdd2esop_time.count());
 	return ret;
 }
 
@@ -5,10 +5,15 @@
 #ifndef LOSYS_BDD_COLLAPSE_HPP
 #define LOSYS_BDD_COLLAPSE_HPP
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <cstdint>
+#include <cstdlib>
+#include <functional>
 #include <map>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility> /* std::pair */
 
@@ -17,64 +22,260 @@ extern "C" {
 #include <cudd.h>
 }
 
+#include "base/collapse.hpp"
+#include "io/write_pla.hpp"
 #include "kernel/cube32.hpp"
+#include "kernel/cube32_batch.hpp"
 #include "kernel/two_lvl32.hpp"
 
 namespace lsy {
 
 /*------------------------------------------------------------------------------
 | Pseudo-Kronecker (PSDKRO) expressions
+|
+| The costs of the expansions are cached per regular BDD node, with a slot for
+| the node and one for its complement, and kept across outputs: nodes shared
+| by several outputs are costed once. The cache holds no reference, so that
+| CUDD reclaims the nodes as usual, and is keyed by node addresses: it is
+| dropped as soon as CUDD collected garbage, which only happens within the
+| XORs computed here or in between extractions, or reordered. Automatic
+| reordering is suspended while extracting. Nodes left uncosted by a garbage
+| collection are costed again when needed.
+|
+| The XORs of the cofactors, needed by the Davio expansions, are computed once
+| per node while costing and reused when generating the cubes. They are held
+| referenced until the end of the extraction only, so the nodes alive after an
+| extraction are those alive before.
+|
+| The paths of a PSDKRO lead to distinct cubes, so they are streamed to a sink
+| in batches as they are generated rather than collected in a set, see
+| 'cube32_batch' and 'bdd_write_pla'.
+|
+| Both passes walk the BDD with an explicit stack. While generating, the path
+| is carried as a cube accumulated along with each node, so any subtree can be
+| generated on its own from the cube leading to it.
 *-----------------------------------------------------------------------------*/
 class psdkro {
 public:
+	/* Cofactor XORs computed, reused and the time spent computing them */
+	struct xor_stats {
+		std::uint64_t n_computed = 0u;
+		std::uint64_t n_reused = 0u;
+		double seconds = 0.0;
+	};
+
+	/* Receives the cubes in batches of at most 'batch_size' */
+	using cube_sink = cube32_sink;
+	static constexpr std::size_t batch_size = 4096u;
+
 	psdkro(DdManager *, std::uint32_t);
 	std::vector<cube32> extract_esop(DdNode *);
+	std::vector<cube32> extract_esop(DdNode *, const std::vector<std::uint32_t> &);
+	void extract_esop(DdNode *, const cube_sink &);
+	void extract_esop(DdNode *, const std::vector<std::uint32_t> &, const cube_sink &);
+	std::uint64_t count_esop(DdNode *);
+	const xor_stats &stats() const { return m_stats; }
 
 private:
-	enum var_value : std::uint8_t {
-		POSITIVE,
-		NEGATIVE,
-		UNUSED
-	};
 	enum exp_type : std::uint8_t {
 		POSITIVE_DAVIO,
 		NEGATIVE_DAVIO,
 		SHANNON
 	};
 
-	void add_cube(const cube32);
-	void generate_exact(DdNode *);
+	/* Expansion costs of a regular node and of its complement */
+	struct exp_costs {
+		std::array<std::pair<exp_type, std::uint64_t>, 2> costs;
+		std::array<bool, 2> known;
+	};
+
+	void generate_exact(DdNode *, cube32, cube32_batch &);
+	void sync_costs();
+	const std::pair<exp_type, std::uint64_t> *find_cost(DdNode *) const;
+	DdNode *cofactors_xor(DdNode *);
+	void release_xors();
 
-	/* Recursive function */
-	std::pair<exp_type, std::uint32_t> count_cubes(DdNode *);
+	std::pair<exp_type, std::uint64_t> count_cubes(DdNode *);
 
 private:
 	DdManager *m_cudd;
-	std::vector<std::uint32_t> m_vars;
-	std::vector<var_value> m_var_values;
-	std::map<DdNode *, std::pair<exp_type, std::uint32_t>> m_exp_costs;
-	std::unordered_set<cube32, cube32_hash> m_esop;
+	/* Cube variable of each BDD variable */
+	std::vector<std::uint32_t> m_positions;
+	std::unordered_map<DdNode *, exp_costs> m_exp_costs;
+	/* CUDD's counters when the cost cache was last known valid */
+	long m_n_gcs;
+	unsigned m_n_reorders;
+	/* Referenced XOR of the cofactors of each regular node */
+	std::unordered_map<DdNode *, DdNode *> m_xors;
+	xor_stats m_stats;
 };
 
-static two_lvl32 bdd_extract(std::pair<Cudd, std::vector<BDD>> &bdd)
+/*------------------------------------------------------------------------------
+| BDD variables in the support of 'f', in increasing order.
+*-----------------------------------------------------------------------------*/
+static std::vector<std::uint32_t> bdd_support(DdManager *cudd, DdNode *f)
 {
-	if (bdd.first.ReadSize() > 32) {
-		fprintf(stdout, "Cannot handle more than 32 input variables\n");
-		exit(0);
-	}
+	int *indices;
+	const auto n = Cudd_SupportIndices(cudd, f, &indices);
+	std::vector<std::uint32_t> support(indices, indices + n);
+	free(indices);
+	std::sort(support.begin(), support.end());
+	return support;
+}
+
+static void print_stats(const psdkro::xor_stats &stats)
+{
+	printf("[i] Cofactor XORs: %lu computed in %f, %lu reused (~%f saved)\n",
+	       (unsigned long) stats.n_computed, stats.seconds, (unsigned long) stats.n_reused,
+	       stats.n_computed ? stats.seconds * stats.n_reused / stats.n_computed : 0.0);
+}
+
+/*------------------------------------------------------------------------------
+| With more than 32 BDD variables, each output is extracted over its support,
+| which must have at most 32 variables, see 'two_lvl32'.
+|
+| With 'complemented', the PSDKRO of the complement of each output is extracted
+| instead, and XORed with the constant-one cube: another cover of the same
+| output, often of a different size, that can seed a minimization.
+*-----------------------------------------------------------------------------*/
+static two_lvl32 bdd_extract(std::pair<Cudd, std::vector<BDD>> &bdd,
+                             const bool complemented = false)
+{
+	const auto wide = bdd.first.ReadSize() > 32;
 	printf("[i] Collapsing using BDD\n");
 	psdkro mngr(bdd.first.getManager(), bdd.first.ReadSize());
 	std::vector<std::vector<cube32>> fncts;
+	/* Outputs of the same node, complemented or not, refer to the first */
+	std::vector<std::pair<std::uint32_t, bool>> refs;
+	std::map<DdNode *, std::uint32_t> firsts;
+	std::vector<std::vector<std::uint32_t>> supports;
 	auto start = std::chrono::high_resolution_clock::now();
+	/* Extraction over the support of the last output when wide */
+	const auto extract = [&](DdNode *node) {
+		if (complemented)
+			node = Cudd_Not(node);
+		auto esop = wide ? mngr.extract_esop(node, supports.back())
+		                 : mngr.extract_esop(node);
+		if (!complemented)
+			return esop;
+		auto it = std::find(esop.begin(), esop.end(), cube32_one);
+		if (it != esop.end())
+			esop.erase(it);
+		else
+			esop.insert(esop.begin(), cube32_one);
+		return esop;
+	};
 	for (auto &i : bdd.second) {
-		fncts.push_back(mngr.extract_esop(i.getNode()));
+		const auto node = i.getNode();
+		const std::uint32_t out = fncts.size();
+		auto it = firsts.emplace(Cudd_Regular(node), out).first;
+		const auto first = it->second;
+		refs.emplace_back(first, Cudd_IsComplement(node)
+		                         != Cudd_IsComplement(bdd.second[first].getNode()));
+		if (!wide) {
+			fncts.push_back(first == out ? extract(node)
+			                             : std::vector<cube32>());
+			continue;
+		}
+		supports.emplace_back();
+		if (first != out) {
+			fncts.emplace_back();
+			continue;
+		}
+		supports.back() = bdd_support(bdd.first.getManager(), node);
+		if (supports.back().size() > 32) {
+			fprintf(stdout, "Cannot handle outputs of more than 32 support variables\n");
+			exit(0);
+		}
+		fncts.push_back(extract(node));
 	}
 	std::chrono::duration<double> bdd2esop_time =
 		std::chrono::high_resolution_clock::now() - start;
 
+	print_stats(mngr.stats());
 	printf("[i] Elapsed time: %f\n",  bdd2esop_time.count());
-	return {two_lvl32::kind_t::ESOP, (uint32_t) bdd.first.ReadSize(), fncts};
+	return {two_lvl32::kind_t::ESOP, (uint32_t) bdd.first.ReadSize(), fncts, refs, supports};
 }
 
+/*------------------------------------------------------------------------------
+| Sizes of the PSDKROs of the outputs, computed without generating any cube.
+*-----------------------------------------------------------------------------*/
+static void bdd_count(std::pair<Cudd, std::vector<BDD>> &bdd)
+{
+	printf("[i] Counting using BDD\n");
+	psdkro mngr(bdd.first.getManager(), bdd.first.ReadSize());
+	std::map<DdNode *, std::uint32_t> firsts;
+	std::uint64_t n_cubes = 0u;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (auto i = 0u; i < bdd.second.size(); ++i) {
+		const auto node = bdd.second[i].getNode();
+		const auto size = mngr.count_esop(node);
+		const auto first = firsts.emplace(Cudd_Regular(node), i).first->second;
+		if (first != i) {
+			printf("[%u] Cubes: %lu (same node as [%u])\n", i, (unsigned long) size, first);
+			continue;
+		}
+		n_cubes += size;
+		printf("[%u] Cubes: %lu, BDD nodes: %d, Memory: %lu bytes\n", i,
+		       (unsigned long) size, Cudd_DagSize(node),
+		       (unsigned long) (size * sizeof(cube32)));
+	}
+	std::chrono::duration<double> count_time =
+		std::chrono::high_resolution_clock::now() - start;
+
+	printf("[i] Cubes: %lu, Memory: %lu bytes\n", (unsigned long) n_cubes,
+	       (unsigned long) (n_cubes * sizeof(cube32)));
+	printf("[i] Elapsed time: %f\n",  count_time.count());
+}
+
+/*------------------------------------------------------------------------------
+| Extraction streamed to PLA files, one per output as 'write_pla' names them,
+| without holding the cubes: each output is counted first, which costs its
+| nodes for the extraction that follows, and its cubes are then written batch
+| by batch. Outputs of the same node are extracted each, complemented or not.
+| The sizes of the outputs are reported as 'print_stats' does when 'verbose'.
+*-----------------------------------------------------------------------------*/
+static void bdd_write_pla(std::pair<Cudd, std::vector<BDD>> &bdd, const std::string &fname,
+                          bool verbose = false)
+{
+	const auto wide = bdd.first.ReadSize() > 32;
+	printf("[i] Collapsing using BDD (streamed to PLA)\n");
+	psdkro mngr(bdd.first.getManager(), bdd.first.ReadSize());
+	std::uint64_t n_cubes = 0u;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (auto i = 0u; i < bdd.second.size(); ++i) {
+		const auto node = bdd.second[i].getNode();
+		std::vector<std::uint32_t> support;
+		if (wide) {
+			support = bdd_support(bdd.first.getManager(), node);
+			if (support.size() > 32) {
+				fprintf(stdout, "Cannot handle outputs of more than 32 support variables\n");
+				exit(0);
+			}
+		}
+		const auto size = mngr.count_esop(node);
+		pla_writer out(fname + "_" + std::to_string(i) + ".pla", bdd.first.ReadSize(),
+		               size, support);
+		const psdkro::cube_sink sink = [&out](const cube32 *cubes, std::size_t n) {
+			out.write(cubes, n);
+		};
+		if (wide)
+			mngr.extract_esop(node, support, sink);
+		else
+			mngr.extract_esop(node, sink);
+		n_cubes += size;
+		if (verbose)
+			fprintf(stdout, "[%u] Cubes : %5lu\n", i, (unsigned long) size);
+	}
+	std::chrono::duration<double> bdd2esop_time =
+		std::chrono::high_resolution_clock::now() - start;
+
+	print_stats(mngr.stats());
+	printf("[i] Cubes: %lu\n", (unsigned long) n_cubes);
+	printf("[i] Elapsed time: %f\n",  bdd2esop_time.count());
+}
+
+two_lvl32 bdd_extract_cones(Gia_Man_t *, bool, bool, const aig_extr_params &);
+
 } // namespace lsy
 #endif
@@ -5,8 +5,11 @@
 #ifndef LOSYS_WRITE_PLA_HPP
 #define LOSYS_WRITE_PLA_HPP
 
+#include <cassert>
+#include <cstdint>
 #include <fstream>
 #include <sstream>
+#include <string>
 #include <vector>
 
 #include "kernel/cube32.hpp"
@@ -16,18 +19,18 @@ namespace lsy {
 
 /* FIXME: This is horrible, but necessary for now; instead of creating one PLA
    file multiple output cubes, it creates multiple files with one output cubes */
-void write_pla(const std::string &fname, const two_lvl32 &pla)
+static void write_pla(const std::string &fname, const two_lvl32 &pla)
 {
 	std::stringstream name;
-	auto i = 0;
-	for (auto &esop : pla._cubes) {
-		name << fname << "_" << i++ << ".pla";
+	for (auto i = 0u; i < pla._cubes.size(); ++i) {
+		const auto esop = pla.cubes_of(i);
+		name << fname << "_" << i << ".pla";
 		std::ofstream out_file(name.str());
 		out_file << ".i "  << pla._n_inputs << "\n";
 		out_file << ".o 1\n";
 		out_file << ".p " << esop.size() << "\n";
 		for (auto &cube : esop) {
-			out_file << cube.str(pla._n_inputs) << " 1\n";
+			out_file << pla.cube_str(i, cube) << " 1\n";
 		}
 		out_file << ".e\n";
 		out_file.close();
@@ -35,6 +38,54 @@ void write_pla(const std::string &fname, const two_lvl32 &pla)
 	}
 }
 
+/*------------------------------------------------------------------------------
+| PLA file of a single output, written as its cubes are streamed in, e.g. from
+| a cube sink: only the number of cubes, which the header gives, is needed
+| upfront. Cube variable 'j' stands for the input 'support[j]', or for the input
+| 'j' without support, as in 'two_lvl32'.
+*-----------------------------------------------------------------------------*/
+class pla_writer {
+public:
+	pla_writer(const std::string &fname, const std::uint32_t n_inputs,
+	           const std::uint64_t n_cubes, const std::vector<std::uint32_t> &support = {})
+	: m_file(fname), m_n_inputs(n_inputs), m_support(support),
+	  m_n_cubes(n_cubes), m_n_written(0u)
+	{
+		m_file << ".i "  << n_inputs << "\n";
+		m_file << ".o 1\n";
+		m_file << ".p " << n_cubes << "\n";
+	}
+
+	~pla_writer()
+	{
+		assert(m_n_written == m_n_cubes);
+		m_file << ".e\n";
+	}
+
+	void write(const cube32 *cubes, const std::size_t n)
+	{
+		for (auto k = 0u; k < n; ++k) {
+			if (m_support.empty()) {
+				m_file << cubes[k].str(m_n_inputs) << " 1\n";
+				continue;
+			}
+			std::string line(m_n_inputs, '-');
+			const auto lits = cubes[k].str(m_support.size());
+			for (auto var = 0u; var < lits.size(); ++var)
+				line[m_support[var]] = lits[var];
+			m_file << line << " 1\n";
+		}
+		m_n_written += n;
+	}
+
+private:
+	std::ofstream m_file;
+	std::uint32_t m_n_inputs;
+	std::vector<std::uint32_t> m_support;
+	std::uint64_t m_n_cubes;
+	std::uint64_t m_n_written;
+};
+
 } // namespace lsy
 
 #endif
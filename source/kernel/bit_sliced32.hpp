@@ -0,0 +1,159 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#ifndef LOSYS_BIT_SLICED32_HPP
+#define LOSYS_BIT_SLICED32_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "cube32.hpp"
+
+namespace lsy {
+
+/*------------------------------------------------------------------------------
+| bit_sliced32
+| ------
+| TLDR: transposed (vertical) index of a set of cube32 for bulk distance
+|       queries.
+|
+| Cubes live in slots. For each variable, the index keeps the 'mask' and the
+| 'polarity' bits of all slots as bitvectors, grouped in blocks of 512 slots
+| (8 words). The distance of a query cube to all cubes of a block is then
+| computed one variable at a time: the per-slot difference bits are fed to a
+| vertical 2-bit saturating counter (two words per lane, plus an overflow word),
+| so a single pass yields the bitmap of the slots within distance 3.
+|
+| Slots are recycled on erase, so the index can follow a cover as it mutates.
+*-----------------------------------------------------------------------------*/
+class bit_sliced32 {
+public:
+	static constexpr std::uint32_t block_words = 8u;
+	static constexpr std::uint32_t block_slots = 64u * block_words;
+
+	explicit bit_sliced32(const std::uint32_t n_vars)
+	: m_n_vars(n_vars)
+	{ assert(n_vars <= 32u); }
+
+	std::uint32_t size() const
+	{ return m_slot.size(); }
+
+	cube32 at(const std::uint32_t slot) const
+	{ return m_cubes[slot]; }
+
+	bool insert(const cube32 c)
+	{
+		if (m_slot.count(c))
+			return false;
+		if (m_free.empty())
+			grow();
+		const auto slot = m_free.back();
+		m_free.pop_back();
+		m_slot.emplace(c, slot);
+		m_cubes[slot] = c;
+		set_slot(slot, c);
+		m_valid[slot / 64u] |= (1ull << (slot % 64u));
+		return true;
+	}
+
+	bool erase(const cube32 c)
+	{
+		auto it = m_slot.find(c);
+		if (it == m_slot.end())
+			return false;
+		const auto slot = it->second;
+		m_slot.erase(it);
+		set_slot(slot, cube32_one);
+		m_valid[slot / 64u] &= ~(1ull << (slot % 64u));
+		m_free.push_back(slot);
+		return true;
+	}
+
+	/*----------------------------------------------------------------------
+	| Computes the bitmap of the slots holding cubes within 'max_dist'
+	| (at most 3) of the query cube.
+	*---------------------------------------------------------------------*/
+	void candidates(const cube32 c, const std::uint32_t max_dist,
+	                std::vector<std::uint64_t> &bitmap) const
+	{
+		assert(max_dist <= 3u);
+		bitmap.assign(m_valid.size(), 0u);
+		const auto n_blocks = m_valid.size() / block_words;
+		for (auto b = 0u; b < n_blocks; ++b) {
+			const auto *valid = &m_valid[b * block_words];
+			std::uint64_t s0[block_words] = {0u};
+			std::uint64_t s1[block_words] = {0u};
+			std::uint64_t over[block_words] = {0u};
+			const auto *slices = &m_slices[b * m_n_vars * 2u * block_words];
+			for (auto v = 0u; v < m_n_vars; ++v) {
+				const auto *mask = slices + (2u * v) * block_words;
+				const auto *polarity = mask + block_words;
+				const std::uint64_t q_mask = -(std::uint64_t)((c.mask >> v) & 1u);
+				const std::uint64_t q_polarity = -(std::uint64_t)((c.polarity >> v) & 1u);
+				std::uint64_t done = ~0ull;
+				for (auto k = 0u; k < block_words; ++k) {
+					const auto d = (mask[k] ^ q_mask) | (polarity[k] ^ q_polarity);
+					const auto carry0 = s0[k] & d;
+					s0[k] ^= d;
+					over[k] |= s1[k] & carry0;
+					s1[k] ^= carry0;
+					done &= over[k] | ~valid[k];
+				}
+				/* Every slot of the block is already too far */
+				if (done == ~0ull)
+					break;
+			}
+			for (auto k = 0u; k < block_words; ++k) {
+				auto within = valid[k] & ~over[k];
+				if (max_dist < 3u)
+					within &= ~(s0[k] & s1[k]);
+				if (max_dist < 2u)
+					within &= ~s1[k];
+				if (max_dist < 1u)
+					within &= ~s0[k];
+				bitmap[b * block_words + k] = within;
+			}
+		}
+	}
+
+private:
+	void grow()
+	{
+		const auto n_slots = m_cubes.size();
+		m_cubes.resize(n_slots + block_slots);
+		m_valid.resize(m_valid.size() + block_words, 0u);
+		m_slices.resize(m_slices.size() + m_n_vars * 2u * block_words, 0u);
+		for (auto slot = n_slots + block_slots; slot > n_slots; --slot)
+			m_free.push_back(slot - 1);
+	}
+
+	void set_slot(const std::uint32_t slot, const cube32 c)
+	{
+		const auto b = slot / block_slots;
+		const auto k = (slot % block_slots) / 64u;
+		const auto bit = 1ull << (slot % 64u);
+		auto *slices = &m_slices[b * m_n_vars * 2u * block_words];
+		for (auto v = 0u; v < m_n_vars; ++v) {
+			auto &mask = slices[(2u * v) * block_words + k];
+			auto &polarity = slices[(2u * v + 1u) * block_words + k];
+			mask = ((c.mask >> v) & 1u) ? (mask | bit) : (mask & ~bit);
+			polarity = ((c.polarity >> v) & 1u) ? (polarity | bit) : (polarity & ~bit);
+		}
+	}
+
+private:
+	std::uint32_t m_n_vars;
+	/* Blocks of [variable][mask, polarity][word] */
+	std::vector<std::uint64_t> m_slices;
+	std::vector<std::uint64_t> m_valid;
+	std::vector<cube32> m_cubes;
+	std::vector<std::uint32_t> m_free;
+	std::unordered_map<cube32, std::uint32_t, cube32_hash> m_slot;
+};
+
+} // namespace lsy
+
+#endif
@@ -147,6 +147,24 @@ static cube32 merge(const cube32 lhs, const cube32 rhs)
 	              lhs.polarity ^ (~rhs.polarity & diff));
 }
 
+/*------------------------------------------------------------------------------
+| Writes the non-empty products of 'cube' with the cubes of [first, last) to
+| 'out', returning their number. There is no branch on conflicts: every product
+| is stored and the output only advances past the non-empty ones, so 'out' must
+| have room for 'last - first' cubes.
+*-----------------------------------------------------------------------------*/
+static std::size_t and_compact(const cube32 cube, const cube32 *first,
+                               const cube32 *last, cube32 *out)
+{
+	std::size_t n = 0u;
+	for (; first != last; ++first) {
+		const auto conflict = (cube.polarity ^ first->polarity) & cube.mask & first->mask;
+		out[n].value = cube.value | first->value;
+		n += (conflict == 0u);
+	}
+	return n;
+}
+
 struct cube32_hash {
 	std::size_t operator()(const cube32 &c) const {
 		return std::hash<std::uint64_t>()(c.value);
@@ -0,0 +1,62 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#ifndef LOSYS_CUBE32_BATCH_HPP
+#define LOSYS_CUBE32_BATCH_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "cube32.hpp"
+
+namespace lsy {
+
+/* Receives cubes in batches */
+using cube32_sink = std::function<void(const cube32 *, std::size_t)>;
+
+/*------------------------------------------------------------------------------
+| cube32_batch
+| ------
+| TLDR: buffer handing the cubes pushed to a sink in batches of at most
+|       'capacity' cubes, in the order they were pushed.
+|
+| A full batch is handed over as soon as it fills up, the last, partial, one on
+| 'flush', which must be called once all the cubes are pushed. An empty batch
+| is never handed over.
+*-----------------------------------------------------------------------------*/
+class cube32_batch {
+public:
+	cube32_batch(const cube32_sink &sink, const std::size_t capacity)
+	: m_sink(sink), m_capacity(capacity)
+	{
+		assert(capacity > 0u);
+		m_cubes.reserve(capacity);
+	}
+
+	void push(const cube32 cube)
+	{
+		m_cubes.push_back(cube);
+		if (m_cubes.size() == m_capacity)
+			flush();
+	}
+
+	void flush()
+	{
+		if (m_cubes.empty())
+			return;
+		m_sink(m_cubes.data(), m_cubes.size());
+		m_cubes.clear();
+	}
+
+private:
+	const cube32_sink &m_sink;
+	std::size_t m_capacity;
+	std::vector<cube32> m_cubes;
+};
+
+} // namespace lsy
+
+#endif
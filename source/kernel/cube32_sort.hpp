@@ -0,0 +1,147 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#ifndef LOSYS_CUBE32_SORT_HPP
+#define LOSYS_CUBE32_SORT_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "cube32.hpp"
+
+namespace lsy {
+
+/*------------------------------------------------------------------------------
+| Bulk ESOP canonicalization
+| ------
+| TLDR: instead of hashing each product into a set, append the products into a
+|       flat array, sort it and cancel equal cubes in one linear sweep.
+|
+| Under XOR, a cube appearing an even number of times cancels out, so once the
+| cubes are sorted only the runs of odd length survive (as a single cube). A
+| further sweep can merge sorted neighbors at distance 1, which are the cubes
+| differing in a single polarity bit or, for the literals of the highest
+| variables, a single mask bit.
+*-----------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+| LSD radix sort of the 64-bit cube values, one byte per pass. Passes on bytes
+| that are the same for all cubes are skipped.
+*-----------------------------------------------------------------------------*/
+static void radix_sort(std::vector<cube32> &cubes)
+{
+	if (cubes.size() < 64u) {
+		std::sort(cubes.begin(), cubes.end());
+		return;
+	}
+	std::vector<cube32> tmp(cubes.size());
+	std::array<std::array<std::uint32_t, 256>, 8> counts = {};
+	for (const auto &c : cubes) {
+		for (auto pass = 0u; pass < 8u; ++pass)
+			++counts[pass][(c.value >> (8u * pass)) & 0xFFu];
+	}
+	for (auto pass = 0u; pass < 8u; ++pass) {
+		auto &count = counts[pass];
+		const auto digit = (cubes.front().value >> (8u * pass)) & 0xFFu;
+		if (count[digit] == cubes.size())
+			continue;
+		std::uint32_t offset = 0u;
+		for (auto &n : count) {
+			const auto tmp_n = n;
+			n = offset;
+			offset += tmp_n;
+		}
+		for (const auto &c : cubes)
+			tmp[count[(c.value >> (8u * pass)) & 0xFFu]++] = c;
+		cubes.swap(tmp);
+	}
+}
+
+/*------------------------------------------------------------------------------
+| Cancels the equal cubes of a sorted array: of each run of equal cubes, one
+| is kept if the run has odd length and none otherwise.
+*-----------------------------------------------------------------------------*/
+static void xor_cancel(std::vector<cube32> &cubes)
+{
+	auto out = cubes.begin();
+	for (auto it = cubes.begin(); it != cubes.end();) {
+		auto run = it;
+		auto parity = false;
+		while (run != cubes.end() && *run == *it) {
+			parity = !parity;
+			++run;
+		}
+		if (parity)
+			*out++ = *it;
+		it = run;
+	}
+	cubes.erase(out, cubes.end());
+}
+
+/*------------------------------------------------------------------------------
+| Merges two sorted and cancelled arrays into 'out', cancelling the cubes
+| present in both. The result is sorted and cancelled, hence the same as
+| canonicalizing the concatenation of the two arrays.
+*-----------------------------------------------------------------------------*/
+static void merge_cancel(const std::vector<cube32> &a,
+                         const std::vector<cube32> &b,
+                         std::vector<cube32> &out)
+{
+	out.clear();
+	out.reserve(a.size() + b.size());
+	auto it_a = a.begin();
+	auto it_b = b.begin();
+	while (it_a != a.end() && it_b != b.end()) {
+		if (*it_a < *it_b)
+			out.push_back(*it_a++);
+		else if (*it_b < *it_a)
+			out.push_back(*it_b++);
+		else {
+			++it_a;
+			++it_b;
+		}
+	}
+	out.insert(out.end(), it_a, a.end());
+	out.insert(out.end(), it_b, b.end());
+}
+
+/*------------------------------------------------------------------------------
+| Merges adjacent cubes at distance 1 of a sorted and cancelled array in one
+| sweep. Returns the number of merges; when non-zero, the array is no longer
+| sorted.
+*-----------------------------------------------------------------------------*/
+static std::uint32_t merge_neighbors(std::vector<cube32> &cubes)
+{
+	std::uint32_t n_merges = 0u;
+	auto out = cubes.begin();
+	for (auto it = cubes.begin(); it != cubes.end(); ++it) {
+		if (it + 1 != cubes.end() && distance(*it, *(it + 1)) == 1u) {
+			*out++ = merge(*it, *(it + 1));
+			++n_merges;
+			++it;
+			continue;
+		}
+		*out++ = *it;
+	}
+	cubes.erase(out, cubes.end());
+	return n_merges;
+}
+
+/*------------------------------------------------------------------------------
+| Sorts and cancels the cubes. With 'with_merge', neighbor merging and
+| cancelling are repeated until no more merges happen.
+*-----------------------------------------------------------------------------*/
+static void canonicalize(std::vector<cube32> &cubes, const bool with_merge = false)
+{
+	do {
+		radix_sort(cubes);
+		xor_cancel(cubes);
+	} while (with_merge && merge_neighbors(cubes) > 0u);
+}
+
+} // namespace lsy
+
+#endif
@@ -0,0 +1,114 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#ifndef LOSYS_MULTI_INDEX32_HPP
+#define LOSYS_MULTI_INDEX32_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "cube32.hpp"
+
+namespace lsy {
+
+/*------------------------------------------------------------------------------
+| multi_index32
+| ------
+| TLDR: multi-index hashing of a set of cube32 for near neighbor queries.
+|
+| The variables are split into four disjoint blocks and, for each block, cubes
+| are bucketed by their projection (mask and polarity) onto it. Two cubes at
+| distance 'd' differ in at most 'd' blocks, so, by pigeonhole, any cube
+| within distance 3 of a query matches it exactly in at least one block: only
+| the four buckets of the query's projections need to be examined.
+*-----------------------------------------------------------------------------*/
+class multi_index32 {
+public:
+	static constexpr std::uint32_t n_blocks = 4u;
+
+	explicit multi_index32(const std::uint32_t n_vars)
+	: m_size(0u)
+	{
+		assert(n_vars <= 32u);
+		const auto width = (n_vars + n_blocks - 1) / n_blocks;
+		for (auto b = 0u; b < n_blocks; ++b) {
+			const auto lo = std::min(n_vars, b * width);
+			const auto hi = std::min(n_vars, (b + 1) * width);
+			const std::uint64_t vars = ((1ull << hi) - 1) & ~((1ull << lo) - 1);
+			m_block_masks[b] = (vars << 32) | vars;
+		}
+	}
+
+	std::uint32_t size() const
+	{ return m_size; }
+
+	void insert(const cube32 c)
+	{
+		for (auto b = 0u; b < n_blocks; ++b)
+			m_buckets[b][key(c, b)].push_back(c);
+		++m_size;
+	}
+
+	bool erase(const cube32 c)
+	{
+		for (auto b = 0u; b < n_blocks; ++b) {
+			auto it = m_buckets[b].find(key(c, b));
+			if (it == m_buckets[b].end())
+				return false;
+			auto &bucket = it->second;
+			auto pos = std::find(bucket.begin(), bucket.end(), c);
+			if (pos == bucket.end())
+				return false;
+			*pos = bucket.back();
+			bucket.pop_back();
+			if (bucket.empty())
+				m_buckets[b].erase(it);
+		}
+		--m_size;
+		return true;
+	}
+
+	/*----------------------------------------------------------------------
+	| Collects the cubes within 'max_dist' (at most 3) of the query cube.
+	| A cube matching the query in several blocks is reported only for the
+	| first of them.
+	*---------------------------------------------------------------------*/
+	void candidates(const cube32 c, const std::uint32_t max_dist,
+	                std::vector<cube32> &out) const
+	{
+		assert(max_dist <= 3u);
+		out.clear();
+		for (auto b = 0u; b < n_blocks; ++b) {
+			auto it = m_buckets[b].find(key(c, b));
+			if (it == m_buckets[b].end())
+				continue;
+			for (const auto &other : it->second) {
+				auto seen = false;
+				for (auto p = 0u; p < b && !seen; ++p)
+					seen = key(other, p) == key(c, p);
+				if (!seen && distance(c, other) <= max_dist)
+					out.push_back(other);
+			}
+		}
+	}
+
+private:
+	std::uint64_t key(const cube32 c, const std::uint32_t b) const
+	{ return c.value & m_block_masks[b]; }
+
+private:
+	using bucket_map = std::unordered_map<std::uint64_t, std::vector<cube32>>;
+
+	std::uint32_t m_size;
+	std::array<std::uint64_t, n_blocks> m_block_masks;
+	std::array<bucket_map, n_blocks> m_buckets;
+};
+
+} // namespace lsy
+
+#endif
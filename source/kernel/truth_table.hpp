@@ -0,0 +1,132 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#ifndef LOSYS_TRUTH_TABLE_HPP
+#define LOSYS_TRUTH_TABLE_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace lsy {
+
+/*------------------------------------------------------------------------------
+| Truth tables
+| ------
+| TLDR: word-level operations on truth tables stored as arrays of 64-bit
+|       words, bit 'm' being the value of the function for the minterm 'm'.
+|
+| A table of 'n' variables has 2^(n-6) words. Tables of less than 6 variables
+| take one word, their 2^n bits being repeated to fill it: this way, they are
+| also valid tables of more variables, the extra ones being don't cares.
+*-----------------------------------------------------------------------------*/
+static constexpr std::uint64_t tt_vars[6] = {
+	0xAAAAAAAAAAAAAAAAull, 0xCCCCCCCCCCCCCCCCull, 0xF0F0F0F0F0F0F0F0ull,
+	0xFF00FF00FF00FF00ull, 0xFFFF0000FFFF0000ull, 0xFFFFFFFF00000000ull
+};
+
+static inline std::size_t tt_n_words(const std::uint32_t n_vars)
+{
+	return n_vars <= 6u ? 1u : (1u << (n_vars - 6u));
+}
+
+/*------------------------------------------------------------------------------
+| Table of the projection function of variable 'var' among 'n_vars'.
+*-----------------------------------------------------------------------------*/
+static std::vector<std::uint64_t> tt_nth_var(const std::uint32_t n_vars,
+                                             const std::uint32_t var)
+{
+	assert(var < n_vars);
+	std::vector<std::uint64_t> tt(tt_n_words(n_vars));
+	for (auto i = 0u; i < tt.size(); ++i) {
+		if (var < 6u)
+			tt[i] = tt_vars[var];
+		else
+			tt[i] = ((i >> (var - 6u)) & 1u) ? ~0ull : 0ull;
+	}
+	return tt;
+}
+
+/*------------------------------------------------------------------------------
+| Swaps the adjacent variables 'var' and 'var + 1'.
+*-----------------------------------------------------------------------------*/
+static void tt_swap_adjacent(std::vector<std::uint64_t> &tt, const std::uint32_t var)
+{
+	static constexpr std::uint64_t masks[5][3] = {
+		{0x9999999999999999ull, 0x2222222222222222ull, 0x4444444444444444ull},
+		{0xC3C3C3C3C3C3C3C3ull, 0x0C0C0C0C0C0C0C0Cull, 0x3030303030303030ull},
+		{0xF00FF00FF00FF00Full, 0x00F000F000F000F0ull, 0x0F000F000F000F00ull},
+		{0xFF0000FFFF0000FFull, 0x0000FF000000FF00ull, 0x00FF000000FF0000ull},
+		{0xFFFF00000000FFFFull, 0x00000000FFFF0000ull, 0x0000FFFF00000000ull}
+	};
+	if (var < 5u) {
+		const auto shift = 1u << var;
+		for (auto &w : tt) {
+			w = (w & masks[var][0]) | ((w & masks[var][1]) << shift)
+			  | ((w & masks[var][2]) >> shift);
+		}
+	} else if (var == 5u) {
+		assert(tt.size() >= 2u);
+		for (auto i = 0u; i < tt.size(); i += 2u) {
+			const auto lo = tt[i];
+			const auto hi = tt[i + 1];
+			tt[i] = (lo & 0x00000000FFFFFFFFull) | (hi << 32);
+			tt[i + 1] = (lo >> 32) | (hi & 0xFFFFFFFF00000000ull);
+		}
+	} else {
+		const auto step = 1u << (var - 6u);
+		assert(tt.size() >= 4u * step);
+		for (auto i = 0u; i < tt.size(); i += 4u * step) {
+			for (auto j = 0u; j < step; ++j)
+				std::swap(tt[i + step + j], tt[i + 2u * step + j]);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------
+| Expands a table of 'pos.size()' variables to 'n_vars' variables, variable 'j'
+| becoming variable 'pos[j]'. Positions must be increasing.
+*-----------------------------------------------------------------------------*/
+static void tt_expand(std::vector<std::uint64_t> &tt, const std::uint32_t n_vars,
+                      const std::vector<std::uint32_t> &pos)
+{
+	const auto old_size = tt.size();
+	tt.resize(tt_n_words(n_vars));
+	for (auto i = old_size; i < tt.size(); ++i)
+		tt[i] = tt[i - old_size];
+	for (auto j = pos.size(); j-- > 0u;) {
+		assert(pos[j] >= j && pos[j] < n_vars);
+		for (auto var = j; var < pos[j]; ++var)
+			tt_swap_adjacent(tt, var);
+	}
+}
+
+/*------------------------------------------------------------------------------
+| Cofactors of a table of 'n_vars' variables w.r.t. its last variable, as
+| tables of 'n_vars - 1' variables.
+*-----------------------------------------------------------------------------*/
+static void tt_cofactors(const std::uint64_t *tt, const std::uint32_t n_vars,
+                         std::uint64_t *tt0, std::uint64_t *tt1)
+{
+	assert(n_vars > 0u);
+	const auto var = n_vars - 1u;
+	if (var < 6u) {
+		const auto shift = 1u << var;
+		tt0[0] = tt[0] & ~tt_vars[var];
+		tt0[0] |= tt0[0] << shift;
+		tt1[0] = tt[0] & tt_vars[var];
+		tt1[0] |= tt1[0] >> shift;
+		return;
+	}
+	const auto half = tt_n_words(var);
+	for (auto i = 0u; i < half; ++i) {
+		tt0[i] = tt[i];
+		tt1[i] = tt[half + i];
+	}
+}
+
+} // namespace lsy
+
+#endif
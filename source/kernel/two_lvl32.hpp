@@ -5,9 +5,12 @@
 #ifndef LOSYS_TWO_LVL32_HPP
 #define LOSYS_TWO_LVL32_HPP
 
+#include <algorithm>
+#include <cassert>
 #include <cstdint>
 #include <cstdio>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "cube32.hpp"
@@ -25,6 +28,16 @@ namespace lsy {
 | is a Boolean XOR of cubes.
 |
 | FIXME: support for multiple output functions.
+|
+| Outputs can be references to another output, possibly complemented: '_refs'
+| is then indexed by output, each output referring to itself or to an earlier
+| output, and the cubes of a referring output are left empty. No references
+| at all is an empty '_refs'.
+|
+| Functions of more than 32 inputs fit as long as each output depends on at
+| most 32 of them: '_supports' then gives, for each output (referring ones
+| excepted), the inputs in its support, cube variable 'j' standing for the
+| input '_supports[i][j]'. Without '_supports', variable 'j' is input 'j'.
 *-----------------------------------------------------------------------------*/
 struct two_lvl32 {
 	enum class kind_t {
@@ -36,6 +49,89 @@ struct two_lvl32 {
 	kind_t _kind;
 	std::uint32_t _n_inputs;
 	std::vector<std::vector<cube32>> _cubes;
+	std::vector<std::pair<std::uint32_t, bool>> _refs;
+	std::vector<std::vector<std::uint32_t>> _supports;
+
+	bool is_ref(const std::uint32_t i) const
+	{
+		return !_refs.empty() && _refs[i].first != i;
+	}
+
+	/* Output whose cubes and support output 'i' uses */
+	std::uint32_t source_of(const std::uint32_t i) const
+	{
+		return is_ref(i) ? _refs[i].first : i;
+	}
+
+	std::uint32_t n_vars_of(const std::uint32_t i) const
+	{
+		return _supports.empty() ? _n_inputs : _supports[source_of(i)].size();
+	}
+
+	std::uint32_t input_of(const std::uint32_t i, const std::uint32_t var) const
+	{
+		return _supports.empty() ? var : _supports[source_of(i)][var];
+	}
+
+	/* A cube of output 'i' over all the inputs */
+	std::string cube_str(const std::uint32_t i, const cube32 cube) const
+	{
+		if (_supports.empty())
+			return cube.str(_n_inputs);
+		std::string s(_n_inputs, '-');
+		const auto lits = cube.str(n_vars_of(i));
+		for (auto var = 0u; var < lits.size(); ++var)
+			s[input_of(i, var)] = lits[var];
+		return s;
+	}
+
+	/* Cubes of output 'i', complemented by toggling the constant-one cube */
+	std::vector<cube32> cubes_of(const std::uint32_t i) const
+	{
+		if (!is_ref(i))
+			return _cubes[i];
+		auto ret = _cubes[_refs[i].first];
+		if (_refs[i].second) {
+			auto it = std::find(ret.begin(), ret.end(), cube32_one);
+			if (it != ret.end())
+				ret.erase(it);
+			else
+				ret.insert(ret.begin(), cube32_one);
+		}
+		return ret;
+	}
+
+	/* Replaces the references by copies of the cubes they refer to */
+	void expand_refs()
+	{
+		for (auto i = 0u; i < _cubes.size(); ++i) {
+			if (!is_ref(i))
+				continue;
+			_cubes[i] = cubes_of(i);
+			if (!_supports.empty())
+				_supports[i] = _supports[source_of(i)];
+		}
+		_refs.clear();
+	}
+
+	/* Rewrites the cubes over all the inputs, of which there must be at most 32 */
+	void expand_supports()
+	{
+		if (_supports.empty())
+			return;
+		assert(_n_inputs <= 32u);
+		for (auto i = 0u; i < _cubes.size(); ++i) {
+			for (auto &cube : _cubes[i]) {
+				cube32 expanded;
+				for (auto var = 0u; var < n_vars_of(i); ++var) {
+					if ((cube.mask >> var) & 1u)
+						expanded.add_lit(input_of(i, var), (cube.polarity >> var) & 1u);
+				}
+				cube = expanded;
+			}
+		}
+		_supports.clear();
+	}
 
 	void n_inputs(const std::uint32_t n_in)
 	{
@@ -85,8 +181,14 @@ static void print_stats(const two_lvl32 &fnt)
 	} else {
 		fprintf(stdout, "[Two-level]\n");
 	}
-	for (auto i = 0; i < fnt._cubes.size(); ++i)
+	for (auto i = 0; i < fnt._cubes.size(); ++i) {
+		if (fnt.is_ref(i)) {
+			fprintf(stdout, "[%d] Same as %s[%u]\n", i,
+			        fnt._refs[i].second ? "!" : "", fnt._refs[i].first);
+			continue;
+		}
 		fprintf(stdout, "[%d] Cubes : %5lu\n", i, fnt._cubes[i].size());
+	}
 }
 } // namespace lsy
 
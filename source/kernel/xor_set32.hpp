@@ -0,0 +1,166 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#ifndef LOSYS_XOR_SET32_HPP
+#define LOSYS_XOR_SET32_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include "cube32.hpp"
+
+namespace lsy {
+
+/*------------------------------------------------------------------------------
+| xor_set32
+| ------
+| TLDR: set of cube32 under XOR, with a filter in front of the search for
+|       distance-1 merge partners.
+|
+| Adding a cube cancels it when already present. Otherwise, the cube is merged
+| with the first present cube that differs from it in a single variable (by
+| ascending variable, trying both other literal states), and the result is
+| added again, until no partner is left.
+|
+| Looking for a partner naively takes two hash probes per variable, nearly all
+| misses. Instead, the variables are split into four blocks and, for each
+| block, a table of counters records the cubes by their key outside the block
+| (the cube with the block's bits cleared). A partner differing in a variable
+| of a block has the same key for that block, so only the blocks whose counter
+| is non-zero are probed. Counters are indexed by a hash of the key, collisions
+| only cost useless probes: the partners found, and the order in which they are
+| tried, are the same as without the filter.
+*-----------------------------------------------------------------------------*/
+class xor_set32 {
+public:
+	static constexpr std::uint32_t n_blocks = 4u;
+	using const_iterator = std::unordered_set<cube32, cube32_hash>::const_iterator;
+
+	explicit xor_set32(const std::uint32_t n_vars = 32u)
+	: m_log_size(10u)
+	{
+		assert(n_vars <= 32u);
+		const auto width = (n_vars + n_blocks - 1) / n_blocks;
+		for (auto b = 0u; b < n_blocks; ++b) {
+			m_lo[b] = std::min(n_vars, b * width);
+			m_hi[b] = std::min(n_vars, (b + 1) * width);
+			const std::uint64_t vars =
+				((1ull << m_hi[b]) - 1) & ~((1ull << m_lo[b]) - 1);
+			m_block_masks[b] = ~((vars << 32) | vars);
+			m_counts[b].assign(1u << m_log_size, 0u);
+		}
+	}
+
+	std::size_t size() const
+	{ return m_cubes.size(); }
+
+	bool empty() const
+	{ return m_cubes.empty(); }
+
+	const_iterator begin() const
+	{ return m_cubes.begin(); }
+
+	const_iterator end() const
+	{ return m_cubes.end(); }
+
+	void clear()
+	{
+		for (const auto &c : m_cubes)
+			count(c, -1);
+		m_cubes.clear();
+	}
+
+	/* Plain insertion, without cancelling nor merging */
+	void insert(const cube32 c)
+	{
+		if (!m_cubes.insert(c).second)
+			return;
+		count(c, +1);
+		if (m_cubes.size() > (1u << (m_log_size - 1)))
+			grow();
+	}
+
+	void add(cube32 c)
+	{
+		while (true) {
+			if (erase(c))
+				return;
+			if (c == cube32_one)
+				break;
+			auto it = find_partner(c);
+			if (it == m_cubes.end())
+				break;
+			const auto partner = *it;
+			erase(partner);
+			c = merge(c, partner);
+		}
+		insert(c);
+	}
+
+private:
+	const_iterator find_partner(const cube32 c) const
+	{
+		for (auto b = 0u; b < n_blocks; ++b) {
+			if (m_lo[b] == m_hi[b] || m_counts[b][slot(c, b)] == 0u)
+				continue;
+			for (auto i = m_lo[b]; i < m_hi[b]; ++i) {
+				auto c1 = c;
+				c1.rotate(i);
+				auto it = m_cubes.find(c1);
+				if (it != m_cubes.end())
+					return it;
+				c1.rotate(i);
+				it = m_cubes.find(c1);
+				if (it != m_cubes.end())
+					return it;
+			}
+		}
+		return m_cubes.end();
+	}
+
+	bool erase(const cube32 c)
+	{
+		if (!m_cubes.erase(c))
+			return false;
+		count(c, -1);
+		return true;
+	}
+
+	std::uint32_t slot(const cube32 c, const std::uint32_t b) const
+	{
+		const auto key = c.value & m_block_masks[b];
+		return (key * 0x9E3779B97F4A7C15ull) >> (64u - m_log_size);
+	}
+
+	void count(const cube32 c, const int delta)
+	{
+		for (auto b = 0u; b < n_blocks; ++b)
+			m_counts[b][slot(c, b)] += delta;
+	}
+
+	void grow()
+	{
+		++m_log_size;
+		for (auto b = 0u; b < n_blocks; ++b)
+			m_counts[b].assign(1u << m_log_size, 0u);
+		for (const auto &c : m_cubes)
+			count(c, +1);
+	}
+
+private:
+	std::uint32_t m_log_size;
+	std::array<std::uint32_t, n_blocks> m_lo;
+	std::array<std::uint32_t, n_blocks> m_hi;
+	std::array<std::uint64_t, n_blocks> m_block_masks;
+	std::array<std::vector<std::uint32_t>, n_blocks> m_counts;
+	std::unordered_set<cube32, cube32_hash> m_cubes;
+};
+
+} // namespace lsy
+
+#endif
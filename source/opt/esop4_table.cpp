@@ -0,0 +1,92 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "esop4_table.hpp"
+#include "kernel/cube32.hpp"
+
+namespace lsy {
+
+static constexpr auto n_cubes4 = 81u;
+static constexpr std::uint8_t unreached = 0xFFu;
+
+struct esop4_table {
+	std::array<cube32, n_cubes4> cubes;
+	std::array<std::uint16_t, n_cubes4> cube_tts;
+	std::vector<std::uint8_t> size;
+	std::vector<std::uint8_t> last;
+
+	esop4_table()
+	: size(1u << 16, unreached), last(1u << 16, 0u)
+	{
+		/* Enumerate the 3^4 cubes, each variable being '0', '1' or '-' */
+		for (auto i = 0u; i < n_cubes4; ++i) {
+			cube32 c;
+			for (auto v = 0u, code = i; v < 4u; ++v, code /= 3u) {
+				if (code % 3u < 2u)
+					c.add_lit(v, code % 3u);
+			}
+			cubes[i] = c;
+			cube_tts[i] = esop4_truth_table(c);
+		}
+		/* Breadth-first search from the constant 0 */
+		std::vector<std::uint16_t> curr = {0u};
+		std::vector<std::uint16_t> next;
+		size[0] = 0u;
+		for (auto k = 1u; !curr.empty(); ++k) {
+			next.clear();
+			for (const auto f : curr) {
+				for (auto i = 0u; i < n_cubes4; ++i) {
+					const std::uint16_t g = f ^ cube_tts[i];
+					if (size[g] != unreached)
+						continue;
+					size[g] = k;
+					last[g] = i;
+					next.push_back(g);
+				}
+			}
+			std::swap(curr, next);
+		}
+	}
+};
+
+static const esop4_table &table()
+{
+	static const esop4_table instance;
+	return instance;
+}
+
+std::uint16_t esop4_truth_table(const cube32 c)
+{
+	assert(((c.mask | c.polarity) & ~0xFu) == 0u);
+	std::uint16_t tt = 0u;
+	for (auto m = 0u; m < 16u; ++m) {
+		if ((m & c.mask) == (c.polarity & c.mask))
+			tt |= (1u << m);
+	}
+	return tt;
+}
+
+std::uint32_t esop4_min_size(const std::uint16_t tt)
+{
+	return table().size[tt];
+}
+
+std::vector<cube32> esop4_min_cover(std::uint16_t tt)
+{
+	const auto &t = table();
+	std::vector<cube32> cover;
+	while (tt != 0u) {
+		const auto i = t.last[tt];
+		cover.push_back(t.cubes[i]);
+		tt ^= t.cube_tts[i];
+	}
+	return cover;
+}
+
+} // namespace lsy
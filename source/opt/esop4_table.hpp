@@ -0,0 +1,36 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#ifndef LOSYS_ESOP4_TABLE_HPP
+#define LOSYS_ESOP4_TABLE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "kernel/cube32.hpp"
+
+namespace lsy {
+
+/*------------------------------------------------------------------------------
+| Exact minimum ESOPs of 4-variable functions
+| ------
+| TLDR: table with a minimum ESOP for each of the 2^16 functions of up to four
+|       variables, indexed directly by the 16-bit truth table.
+|
+| The table is generated on first use by a breadth-first search over the 81
+| cubes of four variables: every function at distance 'k' from the constant 0
+| has a minimum ESOP of 'k' cubes (no 4-variable function needs more than 6).
+| For each function only its size and the last cube on its BFS path are
+| stored, i.e. 128KB, and covers are rebuilt by walking the path backwards.
+|
+| Cubes are over variables 0..3, bit 'm' of a truth table is the value of the
+| function for the minterm 'm'.
+*-----------------------------------------------------------------------------*/
+std::uint32_t esop4_min_size(const std::uint16_t);
+std::vector<cube32> esop4_min_cover(const std::uint16_t);
+std::uint16_t esop4_truth_table(const cube32);
+
+} // namespace lsy
+
+#endif
@@ -3,12 +3,19 @@
 | See LICENSE for details.
 *-----------------------------------------------------------------------------*/
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <limits>
+#include <random>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "kernel/cube32.hpp"
+#include "kernel/cube32_sort.hpp"
+#include "esop4_table.hpp"
 #include "exorcism32.hpp"
 
 namespace lsy {
@@ -53,6 +60,32 @@ exorlink(cube32 c0, cube32 c1, std::uint32_t dist, std::uint32_t *group)
 	return ret;
 }
 
+/*------------------------------------------------------------------------------
+| Moves the literals of the variables in 'support' to the positions 0..k-1
+| (compress) and back (expand).
+*-----------------------------------------------------------------------------*/
+static cube32 compress(const cube32 c, std::uint32_t support)
+{
+	cube32 ret;
+	for (auto j = 0u; support; ++j, support &= support - 1) {
+		const auto var = __builtin_ctz(support);
+		ret.mask |= ((c.mask >> var) & 1u) << j;
+		ret.polarity |= ((c.polarity >> var) & 1u) << j;
+	}
+	return ret;
+}
+
+static cube32 expand(const cube32 c, std::uint32_t support)
+{
+	cube32 ret;
+	for (auto j = 0u; support; ++j, support &= support - 1) {
+		const auto var = __builtin_ctz(support);
+		ret.mask |= ((c.mask >> j) & 1u) << var;
+		ret.polarity |= ((c.polarity >> j) & 1u) << var;
+	}
+	return ret;
+}
+
 void exorcism_mngr::pairs_bookmark()
 {
 	m_pairs_bookmark[0] = m_pairs[0].size();
@@ -65,6 +98,45 @@ void exorcism_mngr::pairs_rollback()
 	m_pairs[1].resize(m_pairs_bookmark[1]);
 }
 
+void exorcism_mngr::pairs_shuffle(std::uint32_t d)
+{
+	if (m_params.seed != 0u)
+		std::shuffle(m_pairs[d].begin(), m_pairs[d].end(), m_rng);
+}
+
+/*------------------------------------------------------------------------------
+| Publishes the current size as best-known one if it is, and tells whether
+| this run is dominated by another one sharing the same 'best'.
+*-----------------------------------------------------------------------------*/
+bool exorcism_mngr::dominated()
+{
+	if (m_params.best == nullptr)
+		return false;
+	const auto size = n_cubes();
+	auto best = m_params.best->load();
+	while (size < best && !m_params.best->compare_exchange_weak(best, size))
+		;
+	return size > best;
+}
+
+/*------------------------------------------------------------------------------
+| Updates this run's entry in the portfolio's count of stalled runs, 'is_stalled'
+| holding what was last counted, and tells whether every run now stalls.
+*-----------------------------------------------------------------------------*/
+bool exorcism_mngr::all_stalled(bool &is_stalled, bool stalls)
+{
+	if (m_params.stalled == nullptr)
+		return false;
+	if (stalls != is_stalled) {
+		if (stalls)
+			++*m_params.stalled;
+		else
+			--*m_params.stalled;
+		is_stalled = stalls;
+	}
+	return m_params.stalled->load() >= m_params.n_runs;
+}
+
 std::uint32_t exorcism_mngr::n_cubes()
 {
 	std::uint32_t n_cubes = 0;
@@ -73,32 +145,85 @@ std::uint32_t exorcism_mngr::n_cubes()
 	return n_cubes;
 }
 
-int exorcism_mngr::add_cube(const cube32 &c, bool add = true)
+void exorcism_mngr::insert_cube(const cube32 &c)
+{
+	if (!m_cubes[c.n_lits()].insert(c).second)
+		return;
+	if (m_params.search == neighbor_search::bit_sliced)
+		m_index.insert(c);
+	else if (m_params.search == neighbor_search::signature)
+		m_signatures.insert(c);
+}
+
+bool exorcism_mngr::erase_cube(const cube32 &c)
+{
+	if (m_cubes[c.n_lits()].erase(c) == 0)
+		return false;
+	if (m_params.search == neighbor_search::bit_sliced)
+		m_index.erase(c);
+	else if (m_params.search == neighbor_search::signature)
+		m_signatures.erase(c);
+	return true;
+}
+
+/*------------------------------------------------------------------------------
+| Links a new cube 'c' with a cube 'it' of the cover: merges them when their
+| distance is 0 or 1 (returning the gain) and records them as an ExorLink pair
+| otherwise (returning -1).
+*-----------------------------------------------------------------------------*/
+int exorcism_mngr::link_cube(const cube32 &c, const cube32 &it)
+{
+	const auto dist = distance(c, it);
+	if (dist == 1) {
+		auto new_cube = merge(c, it);
+		erase_cube(it);
+		return add_cube(new_cube) + 1;
+	} else if (dist == 0) {
+		erase_cube(it);
+		m_pairs_tmp[0].clear();
+		return 2;
+	} else if (dist <= m_max_dist) {
+		m_pairs_tmp[dist - 2].push_back(std::make_pair(c, it));
+	}
+	return -1;
+}
+
+int exorcism_mngr::add_cube(const cube32 &c, bool add)
 {
 	m_pairs_tmp[0].clear();
 	m_pairs_tmp[1].clear();
 
 	const auto n_lits = c.n_lits();
-	auto begin = std::max((int)(n_lits - m_max_dist), 0);
-	auto end = std::min(m_n_vars, n_lits + m_max_dist);
-	for (auto i = begin; i <= end; ++i) {
-		for (auto it : m_cubes[i]) {
-			const auto dist = distance(c, it);
-			if (dist == 1) {
-				auto new_cube = merge(c, it);
-				m_cubes[i].erase(it);
-				return add_cube(new_cube) + 1;
-			} else if (dist == 0) {
-				m_cubes[i].erase(it);
-				m_pairs_tmp[0].clear();
-				return 2;
-			} else if (dist <= m_max_dist) {
-				m_pairs_tmp[dist - 2].push_back(std::make_pair(c, it));
+	if (m_params.search == neighbor_search::signature) {
+		m_signatures.candidates(c, m_max_dist, m_neighbors);
+		for (const auto &it : m_neighbors) {
+			const auto ret = link_cube(c, it);
+			if (ret >= 0)
+				return ret;
+		}
+	} else if (m_params.search == neighbor_search::bit_sliced) {
+		m_index.candidates(c, m_max_dist, m_candidates);
+		for (auto w = 0u; w < m_candidates.size(); ++w) {
+			for (auto bits = m_candidates[w]; bits; bits &= bits - 1) {
+				const auto slot = 64u * w + __builtin_ctzll(bits);
+				const auto ret = link_cube(c, m_index.at(slot));
+				if (ret >= 0)
+					return ret;
+			}
+		}
+	} else {
+		auto begin = std::max((int)(n_lits - m_max_dist), 0);
+		auto end = std::min(m_n_vars, n_lits + m_max_dist);
+		for (auto i = begin; i <= end; ++i) {
+			for (auto it : m_cubes[i]) {
+				const auto ret = link_cube(c, it);
+				if (ret >= 0)
+					return ret;
 			}
 		}
 	}
 	if (add) {
-		m_cubes[n_lits].insert(c);
+		insert_cube(c);
 	}
 	for (auto d = 0; d <= (m_max_dist - 2); ++d) {
 		std::copy(m_pairs_tmp[d].begin(), m_pairs_tmp[d].end(), std::back_inserter(m_pairs[d]));
@@ -112,6 +237,7 @@ unsigned exorcism_mngr::exorlink2()
 	std::uint32_t n_reshapes = 0;
 	std::uint32_t old_size = n_cubes();
 	auto &pairs = m_pairs[0];
+	pairs_shuffle(0);
 	auto n_pairs = pairs.size();
 	for (auto i = 0; i < n_pairs; ++i) {
 		const auto cube_pair = pairs.front();
@@ -122,12 +248,10 @@ unsigned exorcism_mngr::exorlink2()
 		std::uint32_t cube1_sz = cube1.n_lits();
 
 		// Remove pair and cubes (cube0, cube1) for now
-		auto cube0_it = m_cubes[cube0_sz].find(cube0);
-		auto cube1_it = m_cubes[cube1_sz].find(cube1);
-		if (cube0_it == m_cubes[cube0_sz].end() || cube1_it == m_cubes[cube1_sz].end())
+		if (m_cubes[cube0_sz].count(cube0) == 0 || m_cubes[cube1_sz].count(cube1) == 0)
 			continue;
-		m_cubes[cube0_sz].erase(cube0_it);
-		m_cubes[cube1_sz].erase(cube1_it);
+		erase_cube(cube0);
+		erase_cube(cube1);
 
 		pairs_bookmark();
 		auto n = exorlink(cube0, cube1, 2, &cube_groups2[0]);
@@ -146,8 +270,8 @@ unsigned exorcism_mngr::exorlink2()
 				add_cube(n[0]);
 			} else {
 				/* TODO: lit minimization ? */
-				m_cubes[cube0_sz].insert(cube0);
-				m_cubes[cube1_sz].insert(cube1);
+				insert_cube(cube0);
+				insert_cube(cube1);
 				--n_reshapes;
 				pairs_rollback();
 				pairs.push_back(cube_pair);
@@ -174,6 +298,7 @@ unsigned exorcism_mngr::exorlink3()
 	std::uint32_t n_reshapes = 0;
 	std::uint32_t old_size = n_cubes();
 	auto &pairs = m_pairs[1];
+	pairs_shuffle(1);
 	auto n_pairs = pairs.size();
 
 	for (auto i = 0; i < n_pairs; ++i) {
@@ -185,12 +310,10 @@ unsigned exorcism_mngr::exorlink3()
 		std::uint32_t cube1_sz = cube1.n_lits();
 
 		// Remove pair and cubes (cube0, cube1) for now
-		auto cube0_it = m_cubes[cube0_sz].find(cube0);
-		auto cube1_it = m_cubes[cube1_sz].find(cube1);
-		if (cube0_it == m_cubes[cube0_sz].end() || cube1_it == m_cubes[cube1_sz].end())
+		if (m_cubes[cube0_sz].count(cube0) == 0 || m_cubes[cube1_sz].count(cube1) == 0)
 			continue;
-		m_cubes[cube0_sz].erase(cube0_it);
-		m_cubes[cube1_sz].erase(cube1_it);
+		erase_cube(cube0);
+		erase_cube(cube1);
 
 		pairs_bookmark();
 		++n_attempts;
@@ -209,8 +332,8 @@ unsigned exorcism_mngr::exorlink3()
 				pairs_rollback();
 			}
 		}
-		m_cubes[cube0_sz].insert(cube0);
-		m_cubes[cube1_sz].insert(cube1);
+		insert_cube(cube0);
+		insert_cube(cube1);
 END_LOOP: {}
 	}
 	auto curr_size = n_cubes();
@@ -227,18 +350,163 @@ END_LOOP: {}
 	return old_size - curr_size;
 }
 
-exorcism_mngr::exorcism_mngr(const std::vector<cube32> &original, std::uint32_t n_vars, bool verbose)
-	: m_cubes(n_vars + 1),
+/*------------------------------------------------------------------------------
+| Windowed exact resynthesis
+|
+| A window is a set of cubes that are identical outside a support 'S' of at
+| most four variables, i.e. a context cube ANDed with a function of 'S'. The
+| XOR of the window is looked up in the table of exact minimum 4-variable
+| ESOPs and the window is replaced whenever the minimum is smaller.
+|
+| The supports tried are the unions of the differing variables of two queued
+| ExorLink pairs sharing a cube, the most frequent first.
+|
+| Windows of five variables are not supported: they would need an NPN
+| canonizer and a table of the exact minimum ESOPs of the 616126 NPN classes of
+| 5-variable functions, which is computable but not shipped. All 4-variable
+| functions fit a table indexed by the raw truth table, without canonization.
+*-----------------------------------------------------------------------------*/
+unsigned exorcism_mngr::resynthesize()
+{
+	std::uint32_t n_windows = 0;
+	std::uint32_t n_replaced = 0;
+	std::uint32_t old_size = n_cubes();
+
+	/* Two pairs sharing a cube span a window of at least three cubes */
+	std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> diffs;
+	for (const auto &pairs : m_pairs) {
+		for (const auto &p : pairs) {
+			const auto diff = difference(p.first, p.second);
+			diffs[p.first.value].push_back(diff);
+			diffs[p.second.value].push_back(diff);
+		}
+	}
+	std::unordered_map<std::uint32_t, std::uint32_t> freq;
+	for (const auto &d : diffs) {
+		const auto n = std::min<std::size_t>(d.second.size(), 16u);
+		for (auto i = 0u; i < n; ++i) {
+			for (auto j = i + 1; j < n; ++j) {
+				const auto support = d.second[i] | d.second[j];
+				if (__builtin_popcount(support) <= 4)
+					++freq[support];
+			}
+		}
+	}
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> supports(freq.begin(), freq.end());
+	std::sort(supports.begin(), supports.end(),
+		[](const std::pair<std::uint32_t, std::uint32_t> &a,
+		   const std::pair<std::uint32_t, std::uint32_t> &b) {
+			return a.second > b.second;
+		});
+	if (supports.size() > m_max_windows)
+		supports.resize(m_max_windows);
+
+	std::unordered_map<std::uint64_t, std::vector<cube32>> windows;
+	for (const auto &s : supports) {
+		const auto support = s.first;
+		assert(__builtin_popcount(support) <= 4);
+		const auto context_mask = ~(((std::uint64_t) support << 32) | support);
+		windows.clear();
+		for (const auto &buckt : m_cubes) {
+			for (const auto &c : buckt)
+				windows[c.value & context_mask].push_back(c);
+		}
+		for (const auto &w : windows) {
+			if (w.second.size() < 3)
+				continue;
+			++n_windows;
+			std::uint16_t tt = 0u;
+			for (const auto &c : w.second)
+				tt ^= esop4_truth_table(compress(c, support));
+			if (esop4_min_size(tt) >= w.second.size())
+				continue;
+			/* Earlier replacements may have merged some of these cubes */
+			const auto alive = std::all_of(w.second.begin(), w.second.end(),
+				[this](const cube32 &c) {
+					return m_cubes[c.n_lits()].count(c) == 1;
+				});
+			if (!alive)
+				continue;
+			for (const auto &c : w.second)
+				erase_cube(c);
+			for (const auto &c : esop4_min_cover(tt))
+				add_cube(cube32{w.first | expand(c, support).value});
+			++n_replaced;
+		}
+	}
+	auto curr_size = n_cubes();
+	if (m_verbose) {
+		fprintf(stdout, "Resynthesis");
+		fprintf(stdout, ": Win= %5u", n_windows);
+		fprintf(stdout, "  Repl= %4u", n_replaced);
+		fprintf(stdout, "  Cubes= %3d", curr_size);
+		fprintf(stdout, "  (%d)", old_size - curr_size);
+		fprintf(stdout, "\n");
+	}
+	return old_size - curr_size;
+}
+
+exorcism_mngr::exorcism_mngr(const std::vector<cube32> &original, std::uint32_t n_vars, bool verbose,
+                             const exorcism_params &params)
+	: m_verbose(verbose),
+	  m_params(params),
+	  m_rng(params.seed),
+	  m_cubes(n_vars + 1),
 	  m_n_vars(n_vars),
+	  m_index(n_vars),
+	  m_signatures(n_vars),
+	  m_pairs(2),
+	  m_pairs_tmp(2),
+	  m_pairs_bookmark({0, 0, 0, 0}),
 	  m_max_dist(3),
+	  m_max_windows(256)
+{
+	for (auto &pairs : m_pairs)
+		pairs.reserve(original.size());
+	/* Cancel duplicated cubes in bulk before linking the survivors */
+	auto cover = original;
+	canonicalize(cover);
+	if (m_params.seed != 0u)
+		std::shuffle(cover.begin(), cover.end(), m_rng);
+	for (const auto &c : cover)
+		add_cube(c);
+}
+
+exorcism_mngr::exorcism_mngr(const std::vector<cube32> &minimized,
+                             const std::vector<cube32> &delta,
+                             std::uint32_t n_vars, bool verbose,
+                             const exorcism_params &params)
+	: m_verbose(verbose),
+	  m_params(params),
+	  m_rng(params.seed),
+	  m_cubes(n_vars + 1),
+	  m_n_vars(n_vars),
+	  m_index(n_vars),
+	  m_signatures(n_vars),
 	  m_pairs(2),
 	  m_pairs_tmp(2),
 	  m_pairs_bookmark({0, 0, 0, 0}),
-	  m_verbose(verbose)
+	  m_max_dist(3),
+	  m_max_windows(256)
+{
+	/* The minimized cover is trusted: no pairs are generated for it */
+	for (const auto &c : minimized) {
+		if (!erase_cube(c))
+			insert_cube(c);
+	}
+	xor_cubes(delta);
+}
+
+/*------------------------------------------------------------------------------
+| XOR the given cubes into the current cover. Pairs left over from a previous
+| run only involve cubes ExorLink already failed to reshape, so they are
+| dropped and the new cubes (and whatever they merge into) seed the queues.
+*-----------------------------------------------------------------------------*/
+void exorcism_mngr::xor_cubes(const std::vector<cube32> &cubes)
 {
 	for (auto &pairs : m_pairs)
-		pairs.reserve(original.size() * original.size());
-	for (const auto &c : original)
+		pairs.clear();
+	for (const auto &c : cubes)
 		add_cube(c);
 }
 
@@ -246,11 +514,13 @@ std::vector<cube32> exorcism_mngr::run()
 {
 	auto gain = 0;
 	auto without_improv = 0;
-	auto iteration = 0;
+	auto iteration = 0u;
+	auto is_stalled = false;
 
 	do {
 		if (m_verbose)
-			fprintf(stdout, "\nITERATION: #%2d\n\n", iteration++);
+			fprintf(stdout, "\nITERATION: #%2u\n\n", iteration);
+		++iteration;
 		gain = 0;
 		gain += exorlink2();
 		gain += exorlink3();
@@ -264,11 +534,21 @@ std::vector<cube32> exorcism_mngr::run()
 		gain += exorlink3();
 		gain += exorlink2();
 		gain += exorlink3();
+		if (gain == 0 && m_params.resynthesis)
+			gain += resynthesize();
 		if (gain > 0)
 			without_improv = 0;
 		else
 			++without_improv;
+		if (dominated() && without_improv > 0)
+			break;
+		if (all_stalled(is_stalled, without_improv > 0))
+			break;
+		if (m_params.max_iterations > 0 && iteration >= m_params.max_iterations)
+			break;
 	} while (without_improv <= 2);
+	/* A finished run stalls for good */
+	all_stalled(is_stalled, true);
 
 	if (m_verbose)
 		fprintf(stdout, "\n");
@@ -279,4 +559,43 @@ std::vector<cube32> exorcism_mngr::run()
 	return result;
 }
 
+std::vector<cube32>
+exorcism_portfolio(const std::vector<std::vector<cube32>> &starts,
+                   std::uint32_t n_vars, std::uint32_t n_runs, bool verbose,
+                   const exorcism_params &base)
+{
+	assert(!starts.empty() && n_runs > 0);
+	std::atomic<std::uint32_t> best{std::numeric_limits<std::uint32_t>::max()};
+	std::atomic<std::uint32_t> stalled{0u};
+	std::vector<std::vector<cube32>> results(n_runs);
+	std::vector<std::thread> workers;
+	for (auto i = 0u; i < n_runs; ++i) {
+		workers.emplace_back([&, i]() {
+			auto params = base;
+			params.seed = i;
+			params.best = &best;
+			params.stalled = &stalled;
+			params.n_runs = n_runs;
+			exorcism_mngr exor(starts[i % starts.size()], n_vars,
+			                   false, params);
+			results[i] = exor.run();
+		});
+	}
+	for (auto &worker : workers)
+		worker.join();
+
+	auto winner = std::min_element(results.begin(), results.end(),
+		[](const std::vector<cube32> &a, const std::vector<cube32> &b) {
+			return a.size() < b.size();
+		});
+	if (verbose) {
+		for (auto i = 0u; i < n_runs; ++i) {
+			fprintf(stdout, "Run %2u (start %2lu, seed %2u): %6lu cubes%s\n",
+			        i, i % starts.size(), i, results[i].size(),
+			        results.begin() + i == winner ? " *" : "");
+		}
+	}
+	return *winner;
+}
+
 } // namespace lsy
@@ -6,40 +6,102 @@
 #define LOSYS_EXORCISM_HPP
 
 #include <array>
+#include <atomic>
+#include <cassert>
 #include <chrono>
+#include <random>
 #include <unordered_set>
 #include <vector>
 
+#include "kernel/bit_sliced32.hpp"
 #include "kernel/cube32.hpp"
+#include "kernel/multi_index32.hpp"
 #include "kernel/two_lvl32.hpp"
 
 namespace lsy {
 
+/*------------------------------------------------------------------------------
+| Exorcism parameters
+|
+| 'seed' shuffles the order in which cubes are loaded and pairs are tried (0
+| keeps the natural order). When 'best' is set, the size reached after each
+| iteration is published there, and a run that stalls above the best-known
+| size gives up. When 'stalled' is set, it counts the runs of a portfolio of
+| 'n_runs' whose last iteration brought no gain, and all of them stop as soon
+| as every run stalls. 'resynthesis' enables the windowed exact resynthesis
+| pass, off by default, which is tried whenever an iteration of ExorLink brings
+| no gain. A non-zero 'max_iterations' bounds the effort, e.g. for intermediate
+| covers.
+|
+| 'search' selects how 'add_cube' finds the neighbors of a new cube: by
+| scanning the literal-count buckets within distance, by a bulk query on a
+| bit-sliced index of the cover, or by looking up the buckets matching the
+| cube's projections in a multi-index hash of the cover (signature).
+*-----------------------------------------------------------------------------*/
+enum class neighbor_search {
+	buckets,
+	bit_sliced,
+	signature
+};
+
+struct exorcism_params {
+	std::uint32_t seed = 0u;
+	std::atomic<std::uint32_t> *best = nullptr;
+	std::atomic<std::uint32_t> *stalled = nullptr;
+	std::uint32_t n_runs = 0u;
+	bool resynthesis = false;
+	neighbor_search search = neighbor_search::signature;
+	std::uint32_t max_iterations = 0u;
+};
+
 /*------------------------------------------------------------------------------
 | Exorcism manager
 |
+| The second constructor takes an already minimized ESOP together with a delta
+| (e.g. cubes changed by an ECO) to be XORed into it. The minimized cubes are
+| loaded as they are, so only the delta cubes, and the cubes they merge into,
+| seed ExorLink pairs. After a run, further deltas can be applied with
+| 'xor_cubes' and the manager re-run.
+|
 | TODO: add support for multiple output functions.
 *-----------------------------------------------------------------------------*/
 class exorcism_mngr {
 public:
-	exorcism_mngr(const std::vector<cube32> &, std::uint32_t, bool);
+	exorcism_mngr(const std::vector<cube32> &, std::uint32_t, bool,
+	              const exorcism_params & = {});
+	exorcism_mngr(const std::vector<cube32> &, const std::vector<cube32> &,
+	              std::uint32_t, bool, const exorcism_params & = {});
 	std::vector<cube32> run();
+	void xor_cubes(const std::vector<cube32> &);
 
 private:
 	std::uint32_t n_cubes();
-	int add_cube(const cube32 &, bool);
+	int add_cube(const cube32 &, bool = true);
+	int link_cube(const cube32 &, const cube32 &);
+	void insert_cube(const cube32 &);
+	bool erase_cube(const cube32 &);
 	int find_pairs(const cube32 &, std::uint32_t);
 	unsigned exorlink2();
 	unsigned exorlink3();
+	unsigned resynthesize();
 
 	void pairs_bookmark();
 	void pairs_rollback();
+	void pairs_shuffle(std::uint32_t);
+	bool dominated();
+	bool all_stalled(bool &, bool);
 
 private:
 	bool m_verbose;
+	exorcism_params m_params;
+	std::mt19937 m_rng;
 	typedef std::unordered_set<cube32, cube32_hash> hash_bucket;
 	std::vector<hash_bucket> m_cubes;
 	std::uint32_t m_n_vars;
+	bit_sliced32 m_index;
+	multi_index32 m_signatures;
+	std::vector<std::uint64_t> m_candidates;
+	std::vector<cube32> m_neighbors;
 
 	std::vector<std::vector<std::pair<cube32, cube32>>> m_pairs;
 	std::vector<std::vector<std::pair<cube32, cube32>>> m_pairs_tmp;
@@ -49,6 +111,7 @@ private:
 
 	/* Algorithm Control */
 	std::uint32_t m_max_dist;
+	std::uint32_t m_max_windows;
 
 	unsigned cube_groups2[8] = {2, 0, 1, 2,
                                     0, 2, 2, 1};
@@ -61,16 +124,73 @@ private:
 	                             0, 0, 2, 0, 2, 1, 2, 1, 1};
 };
 
-static two_lvl32 exorcise(const two_lvl32 &original, bool verbose = false)
+static two_lvl32 exorcise(const two_lvl32 &original, bool verbose = false,
+                          const exorcism_params &params = {})
 {
 	printf("[i] Exorcism\n");
 	std::vector<std::vector<cube32>> ret;
-	for (auto &esop : original._cubes) {
-		exorcism_mngr exor(esop, original._n_inputs, verbose);
+	for (auto i = 0u; i < original._cubes.size(); ++i) {
+		if (original.is_ref(i)) {
+			ret.emplace_back();
+			continue;
+		}
+		exorcism_mngr exor(original._cubes[i], original.n_vars_of(i), verbose, params);
 		ret.push_back(exor.run());
+	}
+	return {original._kind, original._n_inputs, ret, original._refs, original._supports};
+}
 
+std::vector<cube32>
+exorcism_portfolio(const std::vector<std::vector<cube32>> &, std::uint32_t,
+                   std::uint32_t, bool, const exorcism_params & = {});
+
+/*------------------------------------------------------------------------------
+| Portfolio exorcism: for each output, 'n_runs' exorcism instances run on
+| separate threads, cycling through the given starting covers (which must all
+| describe the same functions) with different seeds. Runs share the best-known
+| size, dominated runs give up, and all stop as soon as every run stalls. The
+| smallest cover wins. Runs take 'params' but for the seed and the sharing.
+*-----------------------------------------------------------------------------*/
+static two_lvl32 exorcise_portfolio(const std::vector<two_lvl32> &starts,
+                                    std::uint32_t n_runs, bool verbose = false,
+                                    const exorcism_params &params = {})
+{
+	printf("[i] Exorcism (portfolio: %u runs)\n", n_runs);
+	assert(!starts.empty());
+	const auto &original = starts.front();
+	std::vector<std::vector<cube32>> ret;
+	for (auto i = 0u; i < original._cubes.size(); ++i) {
+		if (original.is_ref(i)) {
+			ret.emplace_back();
+			continue;
+		}
+		std::vector<std::vector<cube32>> esops;
+		for (const auto &start : starts)
+			esops.push_back(start._cubes[i]);
+		ret.push_back(exorcism_portfolio(esops, original.n_vars_of(i),
+		                                 n_runs, verbose, params));
+	}
+	return {original._kind, original._n_inputs, ret, original._refs, original._supports};
+}
+
+static two_lvl32 exorcise_delta(const two_lvl32 &minimized,
+                                const two_lvl32 &delta, bool verbose = false,
+                                const exorcism_params &params = {})
+{
+	printf("[i] Exorcism (incremental)\n");
+	assert(minimized._cubes.size() == delta._cubes.size());
+	std::vector<std::vector<cube32>> ret;
+	for (auto i = 0u; i < minimized._cubes.size(); ++i) {
+		if (minimized.is_ref(i)) {
+			ret.emplace_back();
+			continue;
+		}
+		exorcism_mngr exor(minimized._cubes[i], delta._cubes[i],
+		                   minimized.n_vars_of(i), verbose, params);
+		ret.push_back(exor.run());
 	}
-	return {original._kind, original._n_inputs, ret};
+	return {minimized._kind, minimized._n_inputs, ret, minimized._refs,
+	        minimized._supports};
 }
 
 }
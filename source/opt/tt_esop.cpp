@@ -0,0 +1,141 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "esop4_table.hpp"
+#include "tt_esop.hpp"
+#include "kernel/cube32.hpp"
+#include "kernel/truth_table.hpp"
+
+namespace lsy {
+
+class tt_psdkro {
+public:
+	explicit tt_psdkro(const std::uint32_t n_vars)
+	: m_cofactors(n_vars + 1u), m_costs(n_vars + 1u)
+	{
+		for (auto n = 1u; n <= n_vars; ++n) {
+			for (auto &cofactor : m_cofactors[n])
+				cofactor.resize(tt_n_words(n - 1u));
+		}
+	}
+
+	void generate(const std::uint64_t *tt, const std::uint32_t n_vars, const cube32 cube,
+	              std::vector<cube32> &cubes)
+	{
+		if (is_const0(tt, n_vars))
+			return;
+		if (n_vars == 4u) {
+			for (const auto &c : esop4_min_cover(tt[0] & 0xFFFFu))
+				cubes.push_back(c & cube);
+			return;
+		}
+		if (n_vars == 0u) {
+			cubes.push_back(cube);
+			return;
+		}
+		const auto var = n_vars - 1u;
+		auto &f = split(tt, n_vars);
+		const auto cost0 = cost(f[0].data(), var);
+		const auto cost1 = cost(f[1].data(), var);
+		const auto cost2 = cost(f[2].data(), var);
+		auto neg = cube;
+		auto pos = cube;
+		neg.add_lit(var, 0u);
+		pos.add_lit(var, 1u);
+		if (cost0 + cost2 <= std::min(cost1 + cost2, cost0 + cost1)) {
+			/* Positive Davio: f = f0 ^ x.f2 */
+			generate(f[0].data(), var, cube, cubes);
+			generate(f[2].data(), var, pos, cubes);
+		} else if (cost1 + cost2 <= cost0 + cost1) {
+			/* Negative Davio: f = f1 ^ !x.f2 */
+			generate(f[1].data(), var, cube, cubes);
+			generate(f[2].data(), var, neg, cubes);
+		} else {
+			/* Shannon: f = !x.f0 ^ x.f1 */
+			generate(f[0].data(), var, neg, cubes);
+			generate(f[1].data(), var, pos, cubes);
+		}
+	}
+
+private:
+	std::uint32_t cost(const std::uint64_t *tt, const std::uint32_t n_vars)
+	{
+		if (n_vars == 4u)
+			return esop4_min_size(tt[0] & 0xFFFFu);
+		if (is_const0(tt, n_vars))
+			return 0u;
+		if (n_vars == 0u)
+			return 1u;
+		const auto key = hash(tt, n_vars);
+		auto it = m_costs[n_vars].find(key);
+		if (it != m_costs[n_vars].end())
+			return it->second;
+		auto &f = split(tt, n_vars);
+		const auto cost0 = cost(f[0].data(), n_vars - 1u);
+		const auto cost1 = cost(f[1].data(), n_vars - 1u);
+		const auto cost2 = cost(f[2].data(), n_vars - 1u);
+		const auto ret = std::min({cost0 + cost1, cost0 + cost2, cost1 + cost2});
+		m_costs[n_vars].emplace(key, ret);
+		return ret;
+	}
+
+	/*----------------------------------------------------------------------
+	| Key of the cost cache: the table itself up to 6 variables, a hash of
+	| its words beyond. A collision can only mislead the choice of an
+	| expansion, the cubes generated are always those of the actual table.
+	*---------------------------------------------------------------------*/
+	std::uint64_t hash(const std::uint64_t *tt, const std::uint32_t n_vars) const
+	{
+		const auto n_words = tt_n_words(n_vars);
+		if (n_words == 1u)
+			return tt[0];
+		std::uint64_t h = n_words;
+		for (auto i = 0u; i < n_words; ++i) {
+			h ^= tt[i] + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+			h *= 0xFF51AFD7ED558CCDull;
+		}
+		return h;
+	}
+
+	/* Cofactors f0, f1 and f2 = f0 ^ f1, in the buffers of level 'n_vars' */
+	std::array<std::vector<std::uint64_t>, 3> &split(const std::uint64_t *tt,
+	                                                 const std::uint32_t n_vars)
+	{
+		auto &f = m_cofactors[n_vars];
+		tt_cofactors(tt, n_vars, f[0].data(), f[1].data());
+		for (auto i = 0u; i < f[2].size(); ++i)
+			f[2][i] = f[0][i] ^ f[1][i];
+		return f;
+	}
+
+	bool is_const0(const std::uint64_t *tt, const std::uint32_t n_vars) const
+	{
+		const auto n_words = tt_n_words(n_vars);
+		return std::all_of(tt, tt + n_words, [](std::uint64_t w) { return w == 0u; });
+	}
+
+private:
+	/* Cofactors of each level, which stay valid while the lower levels recur */
+	std::vector<std::array<std::vector<std::uint64_t>, 3>> m_cofactors;
+	/* Costs of the subfunctions met so far, per number of variables */
+	std::vector<std::unordered_map<std::uint64_t, std::uint32_t>> m_costs;
+};
+
+std::vector<cube32> tt_esop(const std::vector<std::uint64_t> &tt, std::uint32_t n_vars)
+{
+	assert(tt.size() == tt_n_words(n_vars));
+	tt_psdkro mngr(n_vars);
+	std::vector<cube32> cubes;
+	mngr.generate(tt.data(), n_vars, cube32_one, cubes);
+	return cubes;
+}
+
+} // namespace lsy
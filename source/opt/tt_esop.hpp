@@ -0,0 +1,32 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#ifndef LOSYS_TT_ESOP_HPP
+#define LOSYS_TT_ESOP_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "kernel/cube32.hpp"
+
+namespace lsy {
+
+/*------------------------------------------------------------------------------
+| ESOP of a truth table
+| ------
+| TLDR: PSDKRO expansion computed on a truth table instead of a BDD.
+|
+| The table (see kernel/truth_table.hpp) is split on its last variable into the
+| cofactors f0, f1 and f2 = f0 ^ f1, and the cheapest of the Shannon, positive
+| and negative Davio expansions is kept at each step, down to 4-variable
+| subfunctions, which take their exact minimum ESOP from the 'esop4' table.
+| As in the BDD version, the costs of subfunctions are cached, so functions
+| with many equal subfunctions are costed once per distinct subfunction.
+| Cubes are over the table variables 0..n_vars-1.
+*-----------------------------------------------------------------------------*/
+std::vector<cube32> tt_esop(const std::vector<std::uint64_t> &, std::uint32_t);
+
+} // namespace lsy
+
+#endif
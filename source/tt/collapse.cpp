@@ -0,0 +1,126 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <cassert>
+#include <chrono>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+extern "C" {
+#include <aig/gia/gia.h>
+}
+
+#include "tt/collapse.hpp"
+#include "kernel/cube32.hpp"
+#include "kernel/truth_table.hpp"
+#include "kernel/two_lvl32.hpp"
+#include "opt/tt_esop.hpp"
+
+namespace lsy {
+
+tt_extr_mngr::tt_extr_mngr(Gia_Man_t *aig)
+	: m_aig(aig), m_n_vars(Gia_ManCiNum(aig))
+{
+	_clogger = spdlog::get("console");
+	_dlogger = spdlog::get("data");
+}
+
+/*------------------------------------------------------------------------------
+| Counts the fanout references of the nodes in the COs' cones, marking them by
+| a reverse topological sweep. Nodes outside the cones keep no reference.
+*-----------------------------------------------------------------------------*/
+void tt_extr_mngr::count_refs()
+{
+	std::uint32_t i;
+	Gia_Obj_t *obj;
+	std::vector<std::uint8_t> used(Gia_ManObjNum(m_aig), 0u);
+
+	m_refs.assign(Gia_ManObjNum(m_aig), 0u);
+	Gia_ManForEachCo(m_aig, obj, i) {
+		++m_refs[Gia_ObjFaninId0p(m_aig, obj)];
+		used[Gia_ObjFaninId0p(m_aig, obj)] = 1u;
+	}
+	for (auto id = Gia_ManObjNum(m_aig) - 1; id > 0; --id) {
+		obj = Gia_ManObj(m_aig, id);
+		if (!used[id] || !Gia_ObjIsAnd(obj))
+			continue;
+		++m_refs[Gia_ObjFaninId0(obj, id)];
+		++m_refs[Gia_ObjFaninId1(obj, id)];
+		used[Gia_ObjFaninId0(obj, id)] = 1u;
+		used[Gia_ObjFaninId1(obj, id)] = 1u;
+	}
+}
+
+void tt_extr_mngr::release(const std::uint32_t idx)
+{
+	assert(m_refs[idx] > 0);
+	if (--m_refs[idx] == 0)
+		std::vector<std::uint64_t>().swap(m_tts[idx]);
+}
+
+two_lvl32 tt_extr_mngr::run(bool verbose = false)
+{
+	using time = std::chrono::high_resolution_clock;
+	std::uint32_t i, id;
+	Gia_Obj_t *obj;
+
+	_clogger->info_if(verbose, "Collapsing using truth tables");
+	if (_dlogger != nullptr) {
+		_dlogger->info("# [%c] - TT collapsing");
+	}
+	count_refs();
+	m_tts.assign(Gia_ManObjNum(m_aig), {});
+	m_tts[0].assign(tt_n_words(m_n_vars), 0u);
+	Gia_ManForEachCiId(m_aig, id, i) {
+		if (m_refs[id] > 0)
+			m_tts[id] = tt_nth_var(m_n_vars, i);
+	}
+
+	/* Simulation */
+	Gia_ManForEachAnd(m_aig, obj, i) {
+		if (m_refs[i] == 0)
+			continue;
+		if (verbose) {
+			fprintf(stdout, "\rNode %6d / %6d", i, Gia_ManObjNum(m_aig));
+			fflush(stdout);
+		}
+		const auto fanin0 = Gia_ObjFaninId0(obj, i);
+		const auto fanin1 = Gia_ObjFaninId1(obj, i);
+		const auto mask0 = Gia_ObjFaninC0(obj) ? ~0ull : 0ull;
+		const auto mask1 = Gia_ObjFaninC1(obj) ? ~0ull : 0ull;
+		const auto &tt0 = m_tts[fanin0];
+		const auto &tt1 = m_tts[fanin1];
+		auto &tt = m_tts[i];
+		tt.resize(tt0.size());
+		for (auto w = 0u; w < tt.size(); ++w)
+			tt[w] = (tt0[w] ^ mask0) & (tt1[w] ^ mask1);
+		release(fanin0);
+		release(fanin1);
+	}
+	if (verbose)
+		fprintf(stdout, "\n");
+
+	/* Extraction */
+	std::vector<std::vector<cube32>> ret(Gia_ManCoNum(m_aig));
+	Gia_ManForEachCo(m_aig, obj, i) {
+		auto start = time::now();
+		const auto driver = Gia_ObjFaninId0p(m_aig, obj);
+		auto tt = m_tts[driver];
+		if (Gia_ObjFaninC0(obj)) {
+			for (auto &w : tt)
+				w = ~w;
+		}
+		release(driver);
+		ret[i] = tt_esop(tt, m_n_vars);
+		std::chrono::duration<double> duration = time::now() - start;
+		_clogger->info_if(verbose, "Output {}: {} cubes", i, ret[i].size());
+		if (_dlogger != nullptr) {
+			_dlogger->info("{},{},-1,-1,{}", i, ret[i].size(), duration.count());
+		}
+	}
+	return {two_lvl32::kind_t::ESOP, m_n_vars, ret};
+}
+
+} // namespace lsy
@@ -0,0 +1,69 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#ifndef LOSYS_TT_COLLAPSE_HPP
+#define LOSYS_TT_COLLAPSE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+extern "C" {
+#include <aig/gia/gia.h>
+}
+
+#include "kernel/cube32.hpp"
+#include "kernel/two_lvl32.hpp"
+
+namespace lsy {
+
+/*------------------------------------------------------------------------------
+| Truth table Extract manager
+|
+| The AIG is simulated into truth tables over all its inputs, in topological
+| order, each table being freed once its last fanout is done. The ESOP of each
+| CO is then obtained by a PSDKRO expansion of its table ('tt_esop'). Tables
+| take 2^(n-6) words, so this is meant for up to about 24 inputs.
+*-----------------------------------------------------------------------------*/
+class tt_extr_mngr {
+public:
+	explicit tt_extr_mngr(Gia_Man_t *);
+	two_lvl32 run(bool);
+
+private:
+	void count_refs();
+	void release(const std::uint32_t);
+
+private:
+	/* Loggers (Console, Data) */
+	std::shared_ptr<spdlog::logger> _clogger;
+	std::shared_ptr<spdlog::logger> _dlogger;
+
+	Gia_Man_t *m_aig;
+	std::uint32_t m_n_vars;
+	std::vector<std::vector<std::uint64_t>> m_tts;
+	std::vector<std::uint32_t> m_refs;
+};
+
+static two_lvl32 tt_extract(Gia_Man_t *aig, bool verbose)
+{
+	if (Gia_ManCiNum(aig) > 24) {
+		spdlog::get("console")
+			->info("Cannot handle more than 24 input variables");
+		exit(0);
+	}
+	tt_extr_mngr mngr(aig);
+	auto start = std::chrono::high_resolution_clock::now();
+	auto ret = mngr.run(verbose);
+	std::chrono::duration<double> tt2esop_time =
+		std::chrono::high_resolution_clock::now() - start;
+	printf("[i] Elapsed time: %f\n",  tt2esop_time.count());
+	return ret;
+}
+
+} // namespace lsy
+
+#endif
@@ -0,0 +1,124 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#ifndef LOSYS_THREAD_POOL_HPP
+#define LOSYS_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lsy {
+
+/*------------------------------------------------------------------------------
+| thread_pool
+| ------
+| TLDR: fixed set of worker threads running blocking parallel loops.
+|
+| 'parallel_for(n, fn)' calls 'fn(i, worker)' for every 'i' in [0, n) and
+| returns once all calls are done. Indices are handed out dynamically, one at a
+| time, and 'worker' (in [0, size())) identifies the thread running the call,
+| so callers can keep per-worker scratch data. The calling thread takes part as
+| worker 0, hence a pool of size 1 runs everything inline.
+*-----------------------------------------------------------------------------*/
+class thread_pool {
+public:
+	explicit thread_pool(std::uint32_t n_threads)
+	: m_n_threads(std::max(n_threads, 1u)), m_generation(0u), m_stop(false)
+	{
+		for (auto w = 1u; w < m_n_threads; ++w)
+			m_workers.emplace_back([this, w]() { work(w); });
+	}
+
+	~thread_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (auto &worker : m_workers)
+			worker.join();
+	}
+
+	thread_pool(const thread_pool &) = delete;
+	thread_pool &operator=(const thread_pool &) = delete;
+
+	std::uint32_t size() const
+	{ return m_n_threads; }
+
+	void parallel_for(const std::size_t n,
+	                  const std::function<void(std::size_t, std::uint32_t)> &fn)
+	{
+		if (m_n_threads == 1u || n <= 1u) {
+			for (auto i = 0u; i < n; ++i)
+				fn(i, 0u);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_fn = &fn;
+			m_n = n;
+			m_next = 0u;
+			m_busy = m_n_threads - 1;
+			++m_generation;
+		}
+		m_wake.notify_all();
+		run(0u);
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this]() { return m_busy == 0u; });
+		m_fn = nullptr;
+	}
+
+private:
+	void run(const std::uint32_t worker)
+	{
+		for (auto i = m_next++; i < m_n; i = m_next++)
+			(*m_fn)(i, worker);
+	}
+
+	void work(const std::uint32_t worker)
+	{
+		auto generation = 0u;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [&]() {
+					return m_stop || m_generation != generation;
+				});
+				if (m_stop)
+					return;
+				generation = m_generation;
+			}
+			run(worker);
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_busy == 0u)
+				m_done.notify_one();
+		}
+	}
+
+private:
+	std::uint32_t m_n_threads;
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	std::uint32_t m_generation;
+	bool m_stop;
+
+	/* Current loop */
+	const std::function<void(std::size_t, std::uint32_t)> *m_fn = nullptr;
+	std::size_t m_n = 0u;
+	std::atomic<std::size_t> m_next{0u};
+	std::uint32_t m_busy = 0u;
+};
+
+} // namespace lsy
+
+#endif
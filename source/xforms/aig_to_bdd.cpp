@@ -66,6 +66,7 @@ std::pair<Cudd, std::vector<BDD>> aig_to_bdd(Gia_Man_t *aig, bool reorder, int v
 		bdd_mngr.AutodynEnable();
 	}
 	printf("[i] Converting AIG to BDD\n");
+	nodes[0] = bdd_mngr.bddZero();
 	Gia_ManForEachCiId(aig, id, i) {
 		nodes[id] = bdd_mngr.bddVar(i);
 	}
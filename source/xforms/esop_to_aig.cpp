@@ -21,7 +21,15 @@ Gia_Man_t *esop_to_aig(const two_lvl32 &esop)
 	Gia_ManHashAlloc(aig);
 	for (auto i = 0; i < esop._n_inputs; ++i)
 		Gia_ManAppendCi(aig);
+	std::vector<int> roots(esop._cubes.size(), 0);
 	for (auto i = 0; i < esop._cubes.size(); ++i) {
+		/* Referring outputs reuse the AIG of their output */
+		if (esop.is_ref(i)) {
+			roots[i] = Abc_LitNotCond(roots[esop._refs[i].first],
+			                          esop._refs[i].second);
+			Gia_ManAppendCo(aig, roots[i]);
+			continue;
+		}
 		auto cubes0 = esop._cubes[i];
 		if (cubes0.empty()) {
 			Gia_ManAppendCo(aig, 0);
@@ -31,15 +39,17 @@ Gia_Man_t *esop_to_aig(const two_lvl32 &esop)
 		for (auto c : cubes0) {
 			int Lit, and_idx = 1;
 			if (c != cube32_one) {
-				for (auto k = 0; k < esop._n_inputs; ++k) {
+				for (auto k = 0u; k < esop.n_vars_of(i); ++k) {
 					if (c.mask & (1 << k)) {
-						Lit = Abc_Var2Lit(k, !((c.polarity >> k) & 1));
+						Lit = Abc_Var2Lit(esop.input_of(i, k),
+						                  !((c.polarity >> k) & 1));
 						and_idx = Gia_ManHashAnd(aig, and_idx, Lit + 2);
 					}
 				}
 			}
 			root_idx = Gia_ManHashXor(aig, root_idx, and_idx);
 		}
+		roots[i] = root_idx;
 		Gia_ManAppendCo(aig, root_idx);
 	}
 	/* Cleanup */
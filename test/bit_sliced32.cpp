@@ -0,0 +1,75 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <catch.hpp>
+
+#include <random>
+#include <vector>
+
+#include "kernel/bit_sliced32.hpp"
+#include "kernel/cube32.hpp"
+
+using namespace lsy;
+
+static cube32 random_cube(std::uint32_t n_vars, std::mt19937 &gen)
+{
+	cube32 c;
+	for (auto v = 0u; v < n_vars; ++v) {
+		const auto lit = gen() % 3;
+		if (lit < 2)
+			c.add_lit(v, lit);
+	}
+	return c;
+}
+
+static std::vector<cube32> within(const bit_sliced32 &index, const cube32 c,
+                                  std::uint32_t max_dist)
+{
+	std::vector<std::uint64_t> bitmap;
+	std::vector<cube32> ret;
+	index.candidates(c, max_dist, bitmap);
+	for (auto w = 0u; w < bitmap.size(); ++w) {
+		for (auto bits = bitmap[w]; bits; bits &= bits - 1)
+			ret.push_back(index.at(64u * w + __builtin_ctzll(bits)));
+	}
+	return ret;
+}
+
+TEST_CASE("bit-sliced distance queries")
+{
+	std::mt19937 gen(1);
+	const auto n_vars = 12u;
+	bit_sliced32 index(n_vars);
+	std::vector<cube32> cubes;
+	for (auto i = 0u; i < 1500u; ++i) {
+		const auto c = random_cube(n_vars, gen);
+		if (index.insert(c))
+			cubes.push_back(c);
+	}
+	/* Erase every third cube so that slots get recycled */
+	for (auto i = 0u; i < cubes.size(); i += 3) {
+		REQUIRE(index.erase(cubes[i]));
+		cubes[i] = cubes.back();
+		cubes.pop_back();
+	}
+	for (auto i = 0u; i < 200u; ++i) {
+		const auto c = random_cube(n_vars, gen);
+		if (index.insert(c))
+			cubes.push_back(c);
+	}
+	REQUIRE(index.size() == cubes.size());
+
+	for (auto i = 0u; i < 100u; ++i) {
+		const auto query = random_cube(n_vars, gen);
+		for (auto max_dist = 0u; max_dist <= 3u; ++max_dist) {
+			auto expected = 0u;
+			for (const auto &c : cubes)
+				expected += distance(query, c) <= max_dist;
+			const auto found = within(index, query, max_dist);
+			REQUIRE(found.size() == expected);
+			for (const auto &c : found)
+				REQUIRE(distance(query, c) <= max_dist);
+		}
+	}
+}
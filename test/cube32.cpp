@@ -4,6 +4,8 @@
 *-----------------------------------------------------------------------------*/
 #include <catch.hpp>
 
+#include <vector>
+
 #include "kernel/cube32.hpp"
 
 using namespace lsy;
@@ -55,3 +57,26 @@ TEST_CASE("and")
 		}
 	}
 }
+
+TEST_CASE("and_compact")
+{
+	const std::vector<cube32> cubes = {
+		cube32_one,
+		cube32{0x1u, 0x1u},
+		cube32{0x1u, 0x0u},
+		cube32{0x6u, 0x2u},
+		cube32{0x3u, 0x0u},
+		cube32{0x8u, 0x8u}
+	};
+	const auto cube = cube32{0x3u, 0x1u};
+	std::vector<cube32> out(cubes.size());
+	const auto n = and_compact(cube, cubes.data(), cubes.data() + cubes.size(), out.data());
+	out.resize(n);
+	std::vector<cube32> expected;
+	for (const auto &c : cubes) {
+		if ((c & cube) != cube32_zero)
+			expected.push_back(c & cube);
+	}
+	REQUIRE(out == expected);
+	REQUIRE(n == 3u);
+}
@@ -0,0 +1,48 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <catch.hpp>
+
+#include <vector>
+
+#include "kernel/cube32.hpp"
+#include "kernel/cube32_batch.hpp"
+
+using namespace lsy;
+
+TEST_CASE("batches flush at capacity")
+{
+	const auto capacity = 4u;
+	std::vector<std::size_t> sizes;
+	std::vector<cube32> received;
+	const cube32_sink sink = [&](const cube32 *cubes, std::size_t n) {
+		sizes.push_back(n);
+		received.insert(received.end(), cubes, cubes + n);
+	};
+	cube32_batch batch(sink, capacity);
+	std::vector<cube32> pushed;
+	for (auto i = 0u; i < 2 * capacity + 1; ++i) {
+		pushed.emplace_back(1u << i, 1u << i);
+		batch.push(pushed.back());
+		REQUIRE(sizes.size() == (i + 1) / capacity);
+	}
+	batch.flush();
+	const auto expected = std::vector<std::size_t>{capacity, capacity, 1u};
+	REQUIRE(sizes == expected);
+	REQUIRE(received == pushed);
+}
+
+TEST_CASE("empty batches are not handed over")
+{
+	auto n_calls = 0u;
+	const cube32_sink sink = [&](const cube32 *, std::size_t) { ++n_calls; };
+	cube32_batch batch(sink, 2u);
+	batch.flush();
+	REQUIRE(n_calls == 0u);
+	batch.push(cube32_one);
+	batch.push(cube32_one);
+	REQUIRE(n_calls == 1u);
+	batch.flush();
+	REQUIRE(n_calls == 1u);
+}
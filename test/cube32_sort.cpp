@@ -0,0 +1,100 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <catch.hpp>
+
+#include <algorithm>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include "kernel/cube32.hpp"
+#include "kernel/cube32_sort.hpp"
+
+using namespace lsy;
+
+static std::vector<cube32> random_cubes(std::uint32_t n_vars,
+                                        std::uint32_t n_cubes,
+                                        std::mt19937 &gen)
+{
+	std::vector<cube32> cubes;
+	for (auto i = 0u; i < n_cubes; ++i) {
+		cube32 c;
+		for (auto v = 0u; v < n_vars; ++v) {
+			const auto lit = gen() % 3;
+			if (lit < 2)
+				c.add_lit(v, lit);
+		}
+		cubes.push_back(c);
+	}
+	return cubes;
+}
+
+static std::vector<bool> truth_table(const std::vector<cube32> &esop,
+                                     std::uint32_t n_vars)
+{
+	std::vector<bool> tt(1u << n_vars, false);
+	for (auto m = 0u; m < tt.size(); ++m) {
+		for (const auto &c : esop) {
+			if ((m & c.mask) == (c.polarity & c.mask))
+				tt[m] = !tt[m];
+		}
+	}
+	return tt;
+}
+
+TEST_CASE("radix sort")
+{
+	std::mt19937 gen(1);
+	for (auto n_cubes : {10u, 100u, 5000u}) {
+		auto cubes = random_cubes(32, n_cubes, gen);
+		auto expected = cubes;
+		std::sort(expected.begin(), expected.end());
+		radix_sort(cubes);
+		REQUIRE(cubes == expected);
+	}
+}
+
+TEST_CASE("merging cancelled arrays")
+{
+	std::mt19937 gen(3);
+	auto a = random_cubes(5, 300, gen);
+	auto b = random_cubes(5, 400, gen);
+	auto expected = a;
+	expected.insert(expected.end(), b.begin(), b.end());
+	canonicalize(expected);
+	canonicalize(a);
+	canonicalize(b);
+	std::vector<cube32> merged;
+	merge_cancel(a, b, merged);
+	REQUIRE(merged == expected);
+}
+
+TEST_CASE("XOR cancellation")
+{
+	std::mt19937 gen(2);
+	/* Few variables, so that there are many duplicates */
+	auto cubes = random_cubes(4, 1000, gen);
+	std::unordered_set<cube32, cube32_hash> expected;
+	for (const auto &c : cubes) {
+		if (!expected.erase(c))
+			expected.insert(c);
+	}
+	const auto tt = truth_table(cubes, 4);
+
+	SECTION("cancelling equal cubes") {
+		canonicalize(cubes);
+		REQUIRE(std::is_sorted(cubes.begin(), cubes.end()));
+		REQUIRE(cubes.size() == expected.size());
+		for (const auto &c : cubes)
+			REQUIRE(expected.count(c) == 1);
+	}
+	SECTION("merging distance-1 neighbors") {
+		canonicalize(cubes, true);
+		REQUIRE(cubes.size() <= expected.size());
+		REQUIRE(truth_table(cubes, 4) == tt);
+		for (auto i = 1u; i < cubes.size(); ++i)
+			REQUIRE(distance(cubes[i - 1], cubes[i]) > 1);
+	}
+}
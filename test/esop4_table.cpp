@@ -0,0 +1,35 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <catch.hpp>
+
+#include "kernel/cube32.hpp"
+#include "opt/esop4_table.hpp"
+
+using namespace lsy;
+
+TEST_CASE("minimum 4-variable ESOPs")
+{
+	SECTION("covers realize their truth tables") {
+		auto max_size = 0u;
+		for (auto tt = 0u; tt < (1u << 16); ++tt) {
+			const auto cover = esop4_min_cover(tt);
+			std::uint16_t cover_tt = 0u;
+			for (const auto &c : cover)
+				cover_tt ^= esop4_truth_table(c);
+			REQUIRE(cover_tt == tt);
+			REQUIRE(cover.size() == esop4_min_size(tt));
+			max_size = std::max(max_size, esop4_min_size(tt));
+		}
+		REQUIRE(max_size == 6u);
+	}
+	SECTION("known minimum sizes") {
+		REQUIRE(esop4_min_size(0x0000) == 0u);
+		REQUIRE(esop4_min_size(0xFFFF) == 1u);
+		/* x0 ^ x1 ^ x2 ^ x3 */
+		REQUIRE(esop4_min_size(0x6996) == 4u);
+		/* x0 | x1 | x2 | x3 */
+		REQUIRE(esop4_min_size(0xFFFE) == 2u);
+	}
+}
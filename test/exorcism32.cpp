@@ -0,0 +1,136 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <catch.hpp>
+
+#include <atomic>
+#include <random>
+#include <vector>
+
+#include "kernel/cube32.hpp"
+#include "opt/exorcism32.hpp"
+
+using namespace lsy;
+
+static std::vector<bool> truth_table(const std::vector<cube32> &esop,
+                                     std::uint32_t n_vars)
+{
+	std::vector<bool> tt(1u << n_vars, false);
+	for (auto m = 0u; m < tt.size(); ++m) {
+		for (const auto &c : esop) {
+			if ((m & c.mask) == (c.polarity & c.mask))
+				tt[m] = !tt[m];
+		}
+	}
+	return tt;
+}
+
+static std::vector<cube32> random_esop(std::uint32_t n_vars,
+                                       std::uint32_t n_cubes,
+                                       std::mt19937 &gen)
+{
+	std::vector<cube32> esop;
+	for (auto i = 0u; i < n_cubes; ++i) {
+		cube32 c;
+		for (auto v = 0u; v < n_vars; ++v) {
+			const auto lit = gen() % 3;
+			if (lit < 2)
+				c.add_lit(v, lit);
+		}
+		esop.push_back(c);
+	}
+	return esop;
+}
+
+TEST_CASE("exorcism preserves the function")
+{
+	std::mt19937 gen(1);
+	for (auto n_vars = 4u; n_vars <= 10u; ++n_vars) {
+		const auto esop = random_esop(n_vars, 8 * n_vars, gen);
+		exorcism_mngr exor(esop, n_vars, false);
+		const auto result = exor.run();
+		REQUIRE(result.size() <= esop.size());
+		REQUIRE(truth_table(result, n_vars) == truth_table(esop, n_vars));
+	}
+}
+
+TEST_CASE("incremental exorcism")
+{
+	std::mt19937 gen(2);
+	const auto n_vars = 10u;
+	auto esop = random_esop(n_vars, 100, gen);
+	const auto minimized = exorcism_mngr(esop, n_vars, false).run();
+
+	SECTION("XORing a delta into a minimized cover") {
+		const auto delta = random_esop(n_vars, 4, gen);
+		exorcism_mngr exor(minimized, delta, n_vars, false);
+		const auto result = exor.run();
+		esop.insert(esop.end(), delta.begin(), delta.end());
+		REQUIRE(truth_table(result, n_vars) == truth_table(esop, n_vars));
+	}
+	SECTION("XORing a cover with itself yields the constant 0") {
+		exorcism_mngr exor(minimized, minimized, n_vars, false);
+		const auto result = exor.run();
+		REQUIRE(truth_table(result, n_vars) ==
+		        std::vector<bool>(1u << n_vars, false));
+	}
+	SECTION("applying successive deltas to the same manager") {
+		exorcism_mngr exor(minimized, {}, n_vars, false);
+		for (auto i = 0u; i < 3u; ++i) {
+			const auto delta = random_esop(n_vars, 3, gen);
+			exor.xor_cubes(delta);
+			esop.insert(esop.end(), delta.begin(), delta.end());
+			REQUIRE(truth_table(exor.run(), n_vars) ==
+			        truth_table(esop, n_vars));
+		}
+	}
+}
+
+TEST_CASE("resynthesis reduces a cover ExorLink stalls on")
+{
+	const auto n_vars = 5u;
+	std::vector<cube32> esop;
+	for (const auto str : {"-1-11", "0-1-0", "000-0", "0001-", "-101-", "001--"}) {
+		cube32 c;
+		for (auto v = 0u; v < n_vars; ++v) {
+			if (str[v] != '-')
+				c.add_lit(v, str[v] == '1');
+		}
+		esop.push_back(c);
+	}
+	exorcism_params params;
+	const auto stalled = exorcism_mngr(esop, n_vars, false, params).run();
+	REQUIRE(stalled.size() == esop.size());
+	params.resynthesis = true;
+	const auto result = exorcism_mngr(esop, n_vars, false, params).run();
+	REQUIRE(result.size() < stalled.size());
+	REQUIRE(truth_table(result, n_vars) == truth_table(esop, n_vars));
+}
+
+TEST_CASE("portfolio exorcism")
+{
+	std::mt19937 gen(3);
+	const auto n_vars = 8u;
+	const auto esop = random_esop(n_vars, 60, gen);
+	const auto best = exorcism_portfolio({esop}, n_vars, 4, false);
+	REQUIRE(best.size() <= esop.size());
+	REQUIRE(truth_table(best, n_vars) == truth_table(esop, n_vars));
+}
+
+TEST_CASE("runs of a portfolio stop once all stall")
+{
+	std::mt19937 gen(4);
+	const auto n_vars = 8u;
+	std::atomic<std::uint32_t> stalled{0u};
+	exorcism_params params;
+	params.stalled = &stalled;
+	params.n_runs = 2u;
+	for (auto i = 0u; i < params.n_runs; ++i) {
+		const auto esop = random_esop(n_vars, 60, gen);
+		exorcism_mngr exor(esop, n_vars, false, params);
+		REQUIRE(truth_table(exor.run(), n_vars) == truth_table(esop, n_vars));
+		/* Finished runs count as stalled */
+		REQUIRE(stalled == i + 1u);
+	}
+}
@@ -0,0 +1,65 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <catch.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "kernel/cube32.hpp"
+#include "kernel/multi_index32.hpp"
+
+using namespace lsy;
+
+static cube32 random_cube(std::uint32_t n_vars, std::mt19937 &gen)
+{
+	cube32 c;
+	for (auto v = 0u; v < n_vars; ++v) {
+		const auto lit = gen() % 3;
+		if (lit < 2)
+			c.add_lit(v, lit);
+	}
+	return c;
+}
+
+TEST_CASE("multi-index neighbor queries")
+{
+	std::mt19937 gen(1);
+	for (auto n_vars : {5u, 13u, 32u}) {
+		multi_index32 index(n_vars);
+		std::vector<cube32> cubes;
+		for (auto i = 0u; i < 1000u; ++i) {
+			const auto c = random_cube(n_vars, gen);
+			if (std::find(cubes.begin(), cubes.end(), c) != cubes.end())
+				continue;
+			index.insert(c);
+			cubes.push_back(c);
+		}
+		for (auto i = 0u; i < cubes.size(); i += 2)
+			REQUIRE(index.erase(cubes[i]));
+		for (auto i = 0u; i < cubes.size(); i += 2)
+			REQUIRE_FALSE(index.erase(cubes[i]));
+		std::vector<cube32> alive;
+		for (auto i = 1u; i < cubes.size(); i += 2)
+			alive.push_back(cubes[i]);
+		REQUIRE(index.size() == alive.size());
+
+		std::vector<cube32> found;
+		for (auto i = 0u; i < 100u; ++i) {
+			/* Queries near existing cubes, so that there are hits */
+			auto query = alive[gen() % alive.size()];
+			query.rotate(gen() % n_vars);
+			for (auto max_dist = 0u; max_dist <= 3u; ++max_dist) {
+				index.candidates(query, max_dist, found);
+				auto expected = 0u;
+				for (const auto &c : alive)
+					expected += distance(query, c) <= max_dist;
+				REQUIRE(found.size() == expected);
+				for (const auto &c : found)
+					REQUIRE(distance(query, c) <= max_dist);
+			}
+		}
+	}
+}
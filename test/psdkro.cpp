@@ -0,0 +1,64 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <catch.hpp>
+
+#include <random>
+#include <vector>
+
+#include "bdd/collapse.hpp"
+#include "kernel/cube32.hpp"
+
+using namespace lsy;
+
+/* Random functions of 'n_vars' variables, sharing nodes */
+static std::vector<BDD> random_bdds(Cudd &cudd, const std::uint32_t n_vars,
+                                    const std::uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::vector<BDD> nodes;
+	for (auto i = 0u; i < n_vars; ++i)
+		nodes.push_back(cudd.bddVar(i));
+	for (auto k = 0u; k < 40u; ++k) {
+		auto a = nodes[rng() % nodes.size()];
+		auto b = nodes[rng() % nodes.size()];
+		if (rng() & 1u)
+			a = !a;
+		nodes.push_back(rng() % 3u ? a & b : a ^ b);
+	}
+	return std::vector<BDD>(nodes.end() - 8, nodes.end());
+}
+
+static bool esop_eval(const std::vector<cube32> &esop, const std::uint32_t x)
+{
+	auto value = false;
+	for (const auto &cube : esop)
+		value ^= (x & cube.mask) == (cube.polarity & cube.mask);
+	return value;
+}
+
+TEST_CASE("extraction leaves the live nodes as they were")
+{
+	const auto n_vars = 8u;
+	for (auto seed = 0u; seed < 10u; ++seed) {
+		Cudd cudd;
+		const auto outputs = random_bdds(cudd, n_vars, seed);
+		DdManager *dd = cudd.getManager();
+		const auto baseline = Cudd_ReadNodeCount(dd);
+		psdkro mngr(dd, n_vars);
+		for (const auto &f : outputs) {
+			const auto esop = mngr.extract_esop(f.getNode());
+			REQUIRE(Cudd_ReadNodeCount(dd) == baseline);
+			REQUIRE(mngr.count_esop(f.getNode()) == esop.size());
+			REQUIRE(Cudd_ReadNodeCount(dd) == baseline);
+			for (auto x = 0u; x < (1u << n_vars); ++x) {
+				std::vector<int> inputs(n_vars);
+				for (auto i = 0u; i < n_vars; ++i)
+					inputs[i] = (x >> i) & 1u;
+				const auto value = Cudd_Eval(dd, f.getNode(), inputs.data());
+				REQUIRE(esop_eval(esop, x) == (value == Cudd_ReadOne(dd)));
+			}
+		}
+	}
+}
@@ -0,0 +1,47 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <catch.hpp>
+
+#include <atomic>
+#include <vector>
+
+#include "utils/thread_pool.hpp"
+
+using namespace lsy;
+
+TEST_CASE("every index runs exactly once")
+{
+	thread_pool pool(4u);
+	REQUIRE(pool.size() == 4u);
+	for (auto n : {0u, 1u, 7u, 1000u}) {
+		std::vector<std::atomic<std::uint32_t>> hits(n);
+		std::atomic<bool> bad_worker(false);
+		for (auto &h : hits)
+			h = 0u;
+		pool.parallel_for(n, [&](std::size_t i, std::uint32_t worker) {
+			if (worker >= pool.size())
+				bad_worker = true;
+			++hits[i];
+		});
+		REQUIRE(!bad_worker);
+		for (auto &h : hits)
+			REQUIRE(h == 1u);
+	}
+}
+
+TEST_CASE("per-worker accumulation")
+{
+	thread_pool pool(3u);
+	std::vector<std::uint64_t> sums(pool.size(), 0u);
+	for (auto round = 0u; round < 10u; ++round) {
+		pool.parallel_for(100u, [&](std::size_t i, std::uint32_t worker) {
+			sums[worker] += i;
+		});
+	}
+	std::uint64_t total = 0u;
+	for (auto s : sums)
+		total += s;
+	REQUIRE(total == 10u * 4950u);
+}
@@ -0,0 +1,70 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <catch.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "kernel/truth_table.hpp"
+
+using namespace lsy;
+
+static bool get_bit(const std::vector<std::uint64_t> &tt, std::uint32_t m)
+{
+	return (tt[m >> 6] >> (m & 63u)) & 1u;
+}
+
+static std::vector<std::uint64_t> random_tt(std::uint32_t n_vars, std::mt19937 &gen)
+{
+	std::vector<std::uint64_t> tt(tt_n_words(n_vars));
+	for (auto &w : tt)
+		w = ((std::uint64_t) gen() << 32) | gen();
+	if (n_vars < 6u) {
+		/* Repeat the 2^n significant bits over the word */
+		for (auto shift = 1u << n_vars; shift < 64u; shift <<= 1)
+			tt[0] = (tt[0] & ((1ull << shift) - 1)) | (tt[0] << shift);
+	}
+	return tt;
+}
+
+TEST_CASE("expanding tables")
+{
+	std::mt19937 gen(1);
+	for (auto n_vars : {3u, 6u, 8u, 10u}) {
+		for (auto k = 0u; k <= std::min(n_vars, 4u); ++k) {
+			/* Spread 'k' variables over 'n_vars' */
+			std::vector<std::uint32_t> pos;
+			for (auto j = 0u; j < k; ++j)
+				pos.push_back(std::min<std::uint32_t>(n_vars - k + j, j * 2u + (gen() & 1u)));
+			auto tt = random_tt(k, gen);
+			const auto original = tt;
+			tt_expand(tt, n_vars, pos);
+			REQUIRE(tt.size() == tt_n_words(n_vars));
+			for (auto m = 0u; m < (1u << n_vars); ++m) {
+				auto m_small = 0u;
+				for (auto j = 0u; j < k; ++j)
+					m_small |= ((m >> pos[j]) & 1u) << j;
+				REQUIRE(get_bit(tt, m) == get_bit(original, m_small));
+			}
+		}
+	}
+}
+
+TEST_CASE("cofactors")
+{
+	std::mt19937 gen(2);
+	for (auto n_vars : {1u, 5u, 6u, 7u, 9u}) {
+		const auto tt = random_tt(n_vars, gen);
+		std::vector<std::uint64_t> tt0(tt_n_words(n_vars - 1u));
+		std::vector<std::uint64_t> tt1(tt_n_words(n_vars - 1u));
+		tt_cofactors(tt.data(), n_vars, tt0.data(), tt1.data());
+		const auto half = 1u << (n_vars - 1u);
+		for (auto m = 0u; m < half; ++m) {
+			REQUIRE(get_bit(tt0, m) == get_bit(tt, m));
+			REQUIRE(get_bit(tt1, m) == get_bit(tt, m + half));
+		}
+	}
+}
@@ -0,0 +1,46 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <catch.hpp>
+
+#include <random>
+#include <vector>
+
+#include "kernel/cube32.hpp"
+#include "kernel/truth_table.hpp"
+#include "opt/tt_esop.hpp"
+
+using namespace lsy;
+
+TEST_CASE("ESOP of truth tables")
+{
+	std::mt19937 gen(1);
+	for (auto n_vars : {0u, 2u, 4u, 5u, 7u, 10u}) {
+		std::vector<std::uint64_t> tt(tt_n_words(n_vars));
+		for (auto &w : tt)
+			w = ((std::uint64_t) gen() << 32) | gen();
+		if (n_vars < 6u) {
+			for (auto shift = 1u << n_vars; shift < 64u; shift <<= 1)
+				tt[0] = (tt[0] & ((1ull << shift) - 1)) | (tt[0] << shift);
+		}
+		const auto esop = tt_esop(tt, n_vars);
+		for (auto m = 0u; m < (1u << n_vars); ++m) {
+			auto value = 0u;
+			for (const auto &c : esop) {
+				REQUIRE((c.mask >> n_vars) == 0u);
+				value ^= (m & c.mask) == (c.polarity & c.mask);
+			}
+			REQUIRE(value == ((tt[m >> 6] >> (m & 63u)) & 1u));
+		}
+	}
+}
+
+TEST_CASE("small functions take their minimum ESOP")
+{
+	/* x0 ^ x1 ^ x2 ^ x3 ^ x4 */
+	std::vector<std::uint64_t> tt = {0x6996966996696996ull};
+	REQUIRE(tt_esop(tt, 5u).size() == 5u);
+	tt = {0u};
+	REQUIRE(tt_esop(tt, 3u).empty());
+}
@@ -0,0 +1,106 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+#include "kernel/cube32.hpp"
+#include "kernel/two_lvl32.hpp"
+
+using namespace lsy;
+
+/* Outputs: f = x0.x1 ^ 1, g = !f, h = f, k = x2 ^ x3 and l = !k */
+static two_lvl32 with_refs()
+{
+	const auto x0 = cube32{1u, 1u};
+	const auto x1 = cube32{2u, 2u};
+	const auto x2 = cube32{4u, 4u};
+	const auto x3 = cube32{8u, 8u};
+	return {two_lvl32::kind_t::ESOP, 4u,
+	        {{x0 & x1, cube32_one}, {}, {}, {x2, x3}, {}},
+	        {{0u, false}, {0u, true}, {0u, false}, {3u, false}, {3u, true}}};
+}
+
+TEST_CASE("cubes of referring outputs")
+{
+	const auto esop = with_refs();
+	const auto f = esop._cubes[0];
+	const auto k = esop._cubes[3];
+	REQUIRE(!esop.is_ref(0));
+	REQUIRE(esop.is_ref(1));
+	REQUIRE(esop.source_of(4) == 3u);
+	REQUIRE(esop.cubes_of(0) == f);
+	REQUIRE(esop.cubes_of(2) == f);
+	SECTION("complementing removes the constant-one cube") {
+		REQUIRE(esop.cubes_of(1) == std::vector<cube32>{f[0]});
+	}
+	SECTION("complementing adds a constant-one cube") {
+		auto expected = k;
+		expected.insert(expected.begin(), cube32_one);
+		REQUIRE(esop.cubes_of(4) == expected);
+	}
+}
+
+TEST_CASE("expanding references")
+{
+	auto esop = with_refs();
+	std::vector<std::vector<cube32>> expected;
+	for (auto i = 0u; i < esop._cubes.size(); ++i)
+		expected.push_back(esop.cubes_of(i));
+	esop.expand_refs();
+	REQUIRE(esop._refs.empty());
+	REQUIRE(esop._cubes == expected);
+	for (auto i = 0u; i < esop._cubes.size(); ++i) {
+		REQUIRE(!esop.is_ref(i));
+		REQUIRE(esop.cubes_of(i) == expected[i]);
+	}
+}
+
+/* Outputs over 40 inputs: f = x3.!x35 ^ x39, g = !f and h = x0 */
+static two_lvl32 with_supports()
+{
+	return {two_lvl32::kind_t::ESOP, 40u,
+	        {{cube32{3u, 1u}, cube32{4u, 4u}}, {}, {cube32{1u, 1u}}},
+	        {{0u, false}, {0u, true}, {2u, false}},
+	        {{3u, 35u, 39u}, {}, {0u}}};
+}
+
+TEST_CASE("outputs over supports")
+{
+	const auto esop = with_supports();
+	REQUIRE(esop.n_vars_of(0) == 3u);
+	REQUIRE(esop.n_vars_of(1) == 3u);
+	REQUIRE(esop.n_vars_of(2) == 1u);
+	REQUIRE(esop.input_of(0, 1) == 35u);
+	REQUIRE(esop.input_of(1, 2) == 39u);
+	REQUIRE(esop.input_of(2, 0) == 0u);
+	const auto f = esop.cube_str(0, esop._cubes[0][0]);
+	REQUIRE(f.size() == 40u);
+	REQUIRE(f == "---1-------------------------------0----");
+	REQUIRE(esop.cube_str(1, esop._cubes[0][1])
+	        == "---------------------------------------1");
+	REQUIRE(esop.cube_str(2, esop._cubes[2][0])
+	        == "1---------------------------------------");
+	REQUIRE(esop.cube_str(1, cube32_one) == std::string(40u, '-'));
+}
+
+TEST_CASE("expanding supports")
+{
+	auto esop = with_supports();
+	esop._n_inputs = 32u;
+	esop._supports[0] = {3u, 25u, 31u};
+	esop.expand_refs();
+	esop.expand_supports();
+	REQUIRE(esop._supports.empty());
+	REQUIRE(esop.n_vars_of(0) == 32u);
+	const auto x3_nx25 = cube32{(1u << 3) | (1u << 25), 1u << 3};
+	const auto x31 = cube32{1u << 31, 1u << 31};
+	const auto f = std::vector<cube32>{x3_nx25, x31};
+	const auto g = std::vector<cube32>{cube32_one, x3_nx25, x31};
+	REQUIRE(esop._cubes[0] == f);
+	REQUIRE(esop._cubes[1] == g);
+	REQUIRE(esop._cubes[2] == std::vector<cube32>(1u, cube32{1u, 1u}));
+}
@@ -0,0 +1,67 @@
+/*------------------------------------------------------------------------------
+| This file is distributed under the BSD 2-Clause License.
+| See LICENSE for details.
+*-----------------------------------------------------------------------------*/
+#include <catch.hpp>
+
+#include <algorithm>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include "kernel/cube32.hpp"
+#include "kernel/xor_set32.hpp"
+
+using namespace lsy;
+
+/* Partner search probing every variable */
+static void naive_add(std::unordered_set<cube32, cube32_hash> &esop,
+                      cube32 c, const std::uint32_t n_vars)
+{
+	auto cont = true;
+	while (cont) {
+		cont = false;
+		if (esop.erase(c))
+			return;
+		if (c == cube32_one)
+			break;
+		for (auto i = 0u; i < n_vars && !cont; ++i) {
+			auto c1 = c;
+			for (auto k = 0u; k < 2u && !cont; ++k) {
+				c1.rotate(i);
+				auto it = esop.find(c1);
+				if (it != esop.end()) {
+					c = merge(c, *it);
+					esop.erase(it);
+					cont = true;
+				}
+			}
+		}
+	}
+	esop.insert(c);
+}
+
+TEST_CASE("same fixpoint as the naive partner search")
+{
+	std::mt19937 gen(1);
+	for (auto n_vars : {3u, 10u, 32u}) {
+		xor_set32 set(n_vars);
+		std::unordered_set<cube32, cube32_hash> expected;
+		for (auto i = 0u; i < 5000u; ++i) {
+			cube32 c;
+			for (auto v = 0u; v < n_vars; ++v) {
+				/* Mostly don't cares, so that merges happen */
+				const auto lit = gen() % 8;
+				if (lit < 2)
+					c.add_lit(v, lit);
+			}
+			set.add(c);
+			naive_add(expected, c, n_vars);
+		}
+		REQUIRE(set.size() == expected.size());
+		for (const auto &c : set)
+			REQUIRE(expected.count(c) == 1);
+		set.clear();
+		REQUIRE(set.empty());
+	}
+}
@@ -19,7 +19,9 @@ extern "C" {
 #include "base/collapse.hpp"
 #include "bdd/collapse.hpp"
 #include "io/write_pla.hpp"
+#include "kernel/cube32_sort.hpp"
 #include "opt/exorcism32.hpp"
+#include "tt/collapse.hpp"
 #include "xforms/xforms.hpp"
 
 static void exit_SIGINT(int sig_num)
@@ -69,21 +71,52 @@ int main(int argc, char **argv)
 	/* Default arguments */
 	std::string method = "bdd";
 	auto n_cofactor = 0;
+	auto n_portfolio = 0;
 	auto check    = false;
+	auto count    = false;
 	auto data     = false;
 	auto exorcise = false;
 	auto reorder  = false;
+	auto stream   = false;
 	auto verbose  = false;
 	auto werbose  = false;
+	lsy::aig_extr_params aig_params;
+	lsy::exorcism_params exor_params;
 	app.add_flag("-c,--check", check, "use ABC's cec to check the result.");
+	app.add_flag("--count", count, "only report the ESOP sizes, using BDDs.");
 	app.add_flag("-d,--data_collect", data, "turn on data collection mode.");
 	app.add_flag("-e,--exorcise", exorcise, "apply exorcism in the collapsed result.");
+	app.add_flag("--resynthesis", exor_params.resynthesis,
+	             "exorcism: windowed exact resynthesis, for the result and intermediate ESOPs.");
 	app.add_flag("-r,--reorder", reorder, "BDD automatic variables reordering.");
+	app.add_flag("-s,--stream", stream, "BDD: write the cubes as they are generated, without holding them.");
 	app.add_flag("-v,--verbose", verbose, "verbose mode.");
 	app.add_flag("-w,--werbose", werbose, "very verbose mode");
+	app.add_flag("--radix", aig_params.radix, "AIG: cancel products by radix sort.");
+	app.add_option("-t,--threads", aig_params.n_threads,
+	               "collapse with N threads <1 .. 256>.", true)->check(CLI::Range(1,256));
+	app.add_flag("--partition", aig_params.partition,
+	             "collapse groups of cones separately (AIG: always beyond 32 inputs).");
+	app.add_option("--partition_size", aig_params.partition_size,
+	               "partition: group cones of up to N nodes.", true);
+	app.add_option("--exorcism_size", aig_params.exorcism_size,
+	               "AIG: exorcise intermediate ESOPs of more than N cubes (0: off).", true);
+	app.add_option("--exorcism_growth", aig_params.exorcism_growth,
+	               "AIG: exorcise intermediate ESOPs growing X times over their fanins (0: off).", true);
+	app.add_option("--memo_cone", aig_params.memo_cone,
+	               "AIG: memoize isomorphic cones of up to N nodes (0: off).", true);
+	app.add_option("--tt_support", aig_params.tt_support,
+	               "AIG: collapse nodes of up to N support variables by truth tables <0 .. 16>.", true)
+	   ->check(CLI::Range(0,16));
 	app.add_option("-f,--cofactors", n_cofactor,
 	               "cofactor N variables <1 .. 8>.")->check(CLI::Range(1,8));
-	app.add_set("-m,--method", method, {"aig", "bdd"}, "collapsing method.", true);
+	app.add_option("-p,--portfolio", n_portfolio,
+	               "exorcise with N concurrent runs per output, keeping the best; "
+	               "with the bdd method, runs alternate between the PSDKRO of the "
+	               "outputs and that of their complements, otherwise only their "
+	               "seeds differ <1 .. 64>.")
+	   ->check(CLI::Range(1,64));
+	app.add_set("-m,--method", method, {"aig", "bdd", "tt"}, "collapsing method.", true);
 	app.allow_extras();
 	app.ignore_case();
 
@@ -115,9 +148,36 @@ int main(int argc, char **argv)
 		Gia_ManPrintStats(aig, 0);
 	}
 
+	/* Sizes only: no cofactoring, extraction nor files */
+	if (count) {
+		auto bdd = lsy::aig_to_bdd(aig, reorder, verbose);
+		lsy::bdd_count(bdd);
+		return EXIT_SUCCESS;
+	}
+
+	aig_params.exorcism_resynthesis = exor_params.resynthesis;
+
+	/* Cofactored cubes are stitched over the inputs themselves */
+	if (n_cofactor > 0 && Gia_ManCiNum(aig) > 32) {
+		console->error("Cofactoring needs at most 32 inputs");
+		return EXIT_FAILURE;
+	}
 	if (data) {
 		spdlog::basic_logger_mt("data", method + "_" + filename + ".csv")->set_pattern("%v");
 	}
+
+	/* Cubes go straight to the PLAs, nothing else needs them */
+	if (stream) {
+		if (method != "bdd" || n_cofactor > 0 || aig_params.partition
+		    || check || exorcise || n_portfolio > 0) {
+			console->error("Streaming needs the BDD method, without cofactoring, "
+			               "partitioning, check nor exorcism");
+			return EXIT_FAILURE;
+		}
+		auto bdd = lsy::aig_to_bdd(aig, reorder, verbose);
+		lsy::bdd_write_pla(bdd, method + "_" + filename, verbose | werbose);
+		return EXIT_SUCCESS;
+	}
 	/* Cofactor the original AIG */
 	Gia_Man_t *cf_aigs[(1 << n_cofactor)];
 	for (auto i = 0; i < (1 << n_cofactor); ++i) {
@@ -127,41 +187,79 @@ int main(int argc, char **argv)
 		}
 	}
 
-	/* Collapse the cofactored AIGs */
+	/* Collapse the cofactored AIGs, the portfolio also starts from the BDD
+	 * collapse of the complemented outputs */
+	const auto flip = method == "bdd" && !aig_params.partition && n_portfolio > 0;
 	std::vector<lsy::two_lvl32> cf_results;
+	std::vector<lsy::two_lvl32> cf_flipped;
+	/* Add cofactored variables to all cubes, once the references are
+	 * expanded, as they toggle the constant-one cube, and the cubes are
+	 * over all the inputs */
+	const auto add_cofactor = [&](lsy::two_lvl32 &ret, const int i) {
+		if (n_cofactor > 0) {
+			ret.expand_refs();
+			ret.expand_supports();
+		}
+		for (auto &esop : ret._cubes) {
+			for (auto &cube : esop) {
+				for (auto j = 0; j < n_cofactor; ++j) {
+					cube.add_lit(j, ((i >> j) & 1));
+				}
+			}
+		}
+	};
 	auto i = 0;
 	for (auto &a : cf_aigs) {
 		console->info("[{} / {}] AIG", i, ((1 << n_cofactor) - 1));
 		lsy::two_lvl32 ex_result;
-		if (method == "bdd") {
+		if (method == "bdd" && aig_params.partition) {
+			cf_results.push_back(lsy::bdd_extract_cones(a, reorder, verbose, aig_params));
+		} else if (method == "bdd") {
 			auto bdd = lsy::aig_to_bdd(a, reorder, verbose);
 			cf_results.push_back(lsy::bdd_extract(bdd));
-		} else {
-			cf_results.push_back(lsy::aig_extract(a, verbose));
-		}
-		/* Add cofactored variables to all cubes */
-		for (auto &esop : cf_results.back()._cubes) {
-			for (auto &cube : esop) {
-				for (auto j = 0; j < n_cofactor; ++j) {
-					cube.add_lit(j, ((i >> j) & 1));
-				}
+			if (flip) {
+				cf_flipped.push_back(lsy::bdd_extract(bdd, true));
+				add_cofactor(cf_flipped.back(), i);
 			}
+		} else if (method == "tt") {
+			cf_results.push_back(lsy::tt_extract(a, verbose));
+		} else {
+			cf_results.push_back(lsy::aig_extract(a, verbose, aig_params));
 		}
+		add_cofactor(cf_results.back(), i);
 		i++;
 	}
 
 	/* Stitch the results together */
-	lsy::two_lvl32 result;
-	result.n_inputs(Gia_ManCiNum(aig));
-	result.n_outputs(Gia_ManCoNum(aig));
-	for (auto &ret : cf_results) {
-		for (auto k = 0; k < result._cubes.size(); ++k) {
+	const auto stitch = [&](lsy::two_lvl32 &into, const lsy::two_lvl32 &ret) {
+		for (auto k = 0; k < into._cubes.size(); ++k) {
 			std::copy(ret._cubes[k].begin(),
 				  ret._cubes[k].end(),
-				  std::back_inserter(result._cubes[k]));
+				  std::back_inserter(into._cubes[k]));
+			/* Cubes x.c and !x.c of two cofactors merge into c */
+			if (cf_results.size() > 1u) {
+				lsy::canonicalize(into._cubes[k], true);
+			}
 		}
-		if (exorcise) {
-			result = lsy::exorcise(result, werbose);
+	};
+	lsy::two_lvl32 result;
+	result.n_inputs(Gia_ManCiNum(aig));
+	result.n_outputs(Gia_ManCoNum(aig));
+	/* Output references and supports only carry over from a single result */
+	if (cf_results.size() == 1u) {
+		result._refs = cf_results.front()._refs;
+		result._supports = cf_results.front()._supports;
+	}
+	auto flipped = result;
+	for (auto r = 0u; r < cf_results.size(); ++r) {
+		stitch(result, cf_results[r]);
+		if (flip) {
+			stitch(flipped, cf_flipped[r]);
+			result = lsy::exorcise_portfolio({result, flipped}, n_portfolio, werbose, exor_params);
+		} else if (n_portfolio > 0) {
+			result = lsy::exorcise_portfolio({result}, n_portfolio, werbose, exor_params);
+		} else if (exorcise) {
+			result = lsy::exorcise(result, werbose, exor_params);
 		}
 	}
 	if (verbose | werbose) {
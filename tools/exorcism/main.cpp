@@ -5,6 +5,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <getopt.h>
 #include <unistd.h>
 
 #include "io/read_pla.hpp"
@@ -17,9 +18,10 @@ usage(int status)
 	if (status == EXIT_FAILURE)
 		fprintf(stdout, "Try '-h' for more information\n");
 	else
-		fprintf(stdout, "Usage: exorcism [-hv] <input_file>.pla <output_file>.pla\n\n" \
+		fprintf(stdout, "Usage: exorcism [-hrvw] <input_file>.pla <output_file>.pla\n\n" \
 		        "Options:\n"\
 		        "\t-h\t: display available options.\n" \
+		        "\t-r\t: windowed exact resynthesis (--resynthesis).\n" \
 		        "\t-v\t: verbose mode.\n" \
 		        "\t-w\t: very verbose mode.\n");
 	exit(status);
@@ -47,17 +49,26 @@ main(int argc, char **argv)
 	char *out_fname = nullptr;
 	bool verbose = false;
 	bool werbose = false;
+	lsy::exorcism_params params;
 	/* Opts parsing */
 	int opt;
 	extern int optind;
 	extern int optopt;
 	extern char* optarg;
 
-	while ((opt = getopt(argc, argv, "hvw")) != -1) {
+	static const struct option long_opts[] = {
+		{"resynthesis", no_argument, nullptr, 'r'},
+		{nullptr, 0, nullptr, 0}
+	};
+
+	while ((opt = getopt_long(argc, argv, "hrvw", long_opts, nullptr)) != -1) {
 		switch (opt) {
 		case 'h':
 			usage(EXIT_SUCCESS);
 			break;
+		case 'r':
+			params.resynthesis = true;
+			break;
 		case 'v':
 			verbose = true;
 			break;
@@ -84,7 +95,7 @@ main(int argc, char **argv)
 	}
 
 	auto original = lsy::read_pla<lsy::two_lvl32>(in_fname, verbose | werbose);
-	auto result   = lsy::exorcise(original, werbose);
+	auto result   = lsy::exorcise(original, werbose, params);
 	if (verbose | werbose) {
 		fprintf(stdout, "ORIGINAL: "), print_stats(original);
 		fprintf(stdout, "RESULT:   "), print_stats(result);